@@ -50,6 +50,10 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Timer ticks to wait for a completion interrupt before assuming
+   that it was lost and polling the device instead. */
+#define IRQ_TIMEOUT TIMER_FREQ
+
 /* An ATA device. */
 struct ata_disk
   {
@@ -87,6 +91,7 @@ static void identify_ata_device (struct ata_disk *);
 
 static void select_sector (struct ata_disk *, block_sector_t);
 static void issue_pio_command (struct channel *, uint8_t command);
+static void wait_for_completion (const struct ata_disk *);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
@@ -123,7 +128,7 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init (&c->lock, c->name);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -273,7 +278,7 @@ identify_ata_device (struct ata_disk *d)
      into our buffer. */
   select_device_wait (d);
   issue_pio_command (c, CMD_IDENTIFY_DEVICE);
-  sema_down (&c->completion_wait);
+  wait_for_completion (d);
   if (!wait_while_busy (d))
     {
       d->is_ata = false;
@@ -349,7 +354,7 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
   lock_acquire (&c->lock);
   select_sector (d, sec_no);
   issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
+  wait_for_completion (d);
   if (!wait_while_busy (d))
     PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
   input_sector (c, buffer);
@@ -372,7 +377,7 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   if (!wait_while_busy (d))
     PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
   output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  wait_for_completion (d);
   lock_release (&c->lock);
 }
 
@@ -414,6 +419,32 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
+/* Waits for the completion interrupt for the command last issued
+   to disk D.  If none arrives within IRQ_TIMEOUT ticks, assumes
+   that it was lost and returns anyway, leaving it to
+   wait_while_busy() to poll the device for completion.  A lost
+   interrupt that turns up later is reported as unexpected, so
+   that it cannot complete a later command early. */
+static void
+wait_for_completion (const struct ata_disk *d) 
+{
+  struct channel *c = d->channel;
+  enum intr_level old_level;
+  bool lost;
+
+  if (sema_down_timeout (&c->completion_wait, IRQ_TIMEOUT))
+    return;
+
+  old_level = intr_disable ();
+  lost = !sema_try_down (&c->completion_wait);
+  if (lost)
+    c->expecting_interrupt = false;
+  intr_set_level (old_level);
+
+  if (lost)
+    printf ("%s: lost interrupt, polling\n", d->name);
+}
+
 /* Reads a sector from channel C's data register in PIO mode into
    SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
 static void
@@ -514,6 +545,7 @@ interrupt_handler (struct intr_frame *f)
         if (c->expecting_interrupt) 
           {
             inb (reg_status (c));               /* Acknowledge interrupt. */
+            c->expecting_interrupt = false;     /* One per command. */
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
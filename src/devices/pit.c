@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -39,7 +36,8 @@
        it is 1, for the second half it is 0.  This is useful for
        generating a tone on a speaker.
 
-     - Other modes are less useful.
+     - Other modes are less useful here.  See pit_oneshot() for
+       mode 0.
 
    FREQUENCY is the number of periods per second, in Hz. */
 void
@@ -81,3 +79,49 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts the given CHANNEL in the PIT counting down COUNT PIT
+   cycles, between 1 and 65,535, in mode 0.  In mode 0 the
+   channel's output goes low as soon as the count is loaded and
+   goes high once it reaches 0, so channel 0 raises a single
+   timer interrupt COUNT cycles from now.  The counter keeps
+   running down past 0, but the output stays high until the
+   channel is reprogrammed. */
+void
+pit_oneshot (int channel, unsigned count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (count >= 1 && count <= 0xffff);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current count of the given CHANNEL in the PIT, and
+   stores the state of the channel's output in *OUTPUT.  Both are
+   latched together by one read-back command, so they are
+   consistent with each other. */
+unsigned
+pit_read_channel (int channel, bool *output)
+{
+  uint8_t status, low, high;
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Read-back command: latch count and status of CHANNEL. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  low = inb (PIT_PORT_COUNTER (channel));
+  high = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  *output = (status & 0x80) != 0;
+  return low | (high << 8);
+}
@@ -1,9 +1,11 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
@@ -20,13 +22,95 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* Number of PIT cycles in a timer tick. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest interval the PIT can time in one-shot mode, in PIT
+   cycles. */
+#define ONESHOT_MAX 0xffff
+
+/* Dynamic ticks.
+
+   Normally the PIT interrupts TIMER_FREQ times per second.  When
+   the CPU is idle, or a thread sleeps for less than a tick, the
+   PIT is instead put in one-shot mode and armed for the next
+   event that needs a timer interrupt, up to ONESHOT_MAX PIT
+   cycles away.  The one-shot was started TICK_PHASE cycles into
+   tick `ticks' and runs for ONESHOT_LEN cycles, so the time can
+   still be read off the PIT (see now_cycles()), and each timer
+   interrupt catches up on all the ticks that went by, calling
+   thread_tick() once for each of them.  Once there is again a
+   thread that needs time slicing and we are at a tick boundary,
+   the PIT goes back to interrupting periodically. */
+static bool oneshot;            /* PIT channel 0 in one-shot mode? */
+static unsigned oneshot_len;    /* Length of one-shot, in PIT cycles. */
+static unsigned tick_phase;     /* PIT cycles into tick at one-shot start. */
+static int64_t intr_cnt;        /* Number of timer interrupts. */
+
+/* List of threads blocked in timer_sleep() and friends, in order
+   of increasing wakeup_time, which is measured in PIT cycles
+   since boot.  Threads with equal wakeup times keep the order in
+   which they went to sleep.  timer_interrupt() only ever needs
+   to look at the front of this list. */
+static struct list sleep_list;
+
+/* Hierarchical timer wheel holding the timers added with
+   timer_add().
+
+   Level 0 has one slot per tick for the next WHEEL_SIZE ticks.
+   Each slot in level L covers WHEEL_SIZE**L ticks, so that the
+   whole wheel spans WHEEL_SPAN ticks; timers further out are
+   parked in the last level and put back in place later.
+   Adding or canceling a timer takes constant time.  Each tick,
+   the timer softirq runs the timers in one level-0 slot, and
+   every WHEEL_SIZE**L ticks it "cascades" one slot of level L,
+   redistributing its timers to lower levels, so that no timer
+   is looked at more than WHEEL_LEVELS times before it runs.
+
+   WHEEL_TIME is the next tick the softirq will process.  The
+   wheel is protected by disabling interrupts. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static int64_t wheel_time;
+static int wheel_cnt;           /* Number of timers in the wheel. */
+
+/* Nanoseconds per second. */
+#define NSEC_PER_SEC 1000000000
+
+/* Number of timer ticks over which timer_calibrate() measures the
+   TSC. */
+#define CALIBRATE_TICKS (TIMER_FREQ / 5)
+
+/* TSC clocksource.
+
+   timer_now_ns() converts the TSC cycles since TSC_BASE into
+   nanoseconds since NS_BASE as (CYCLES * TSC_MULT) >> TSC_SHIFT.
+   timer_calibrate() measures the TSC frequency against the PIT
+   and picks the largest TSC_SHIFT for which TSC_MULT still fits
+   in 32 bits.  Until then, the TSC is assumed to run at 4 GHz,
+   which errs toward making brief delays too long rather than too
+   short. */
+static uint64_t tsc_base;
+static int64_t ns_base;
+static uint32_t tsc_mult = 1u << 30;
+static int tsc_shift = 32;
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
+static int64_t now_cycles (void);
+static void timer_program (int64_t now, bool idle);
+static void wake_sleepers (int64_t now);
+static void timer_expedite (int64_t when);
+static void sleep_until (int64_t wakeup);
+static bool wakeup_less (const struct list_elem *, const struct list_elem *,
+                         void *aux);
+static int64_t tsc_to_ns (uint64_t cycles);
+static void wheel_insert (struct timer *);
+static void wheel_cascade (int level, int64_t tick);
+static int64_t wheel_next_expiry (void);
+static intr_softirq_func timer_softirq;
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
@@ -35,35 +119,63 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  int level, slot;
+
   pit_configure_channel (0, 2, TIMER_FREQ);
+  list_init (&sleep_list);
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  intr_register_softirq (SOFTIRQ_TIMER, timer_softirq);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates the TSC clocksource behind timer_now_ns(), used
+   for high-resolution timing and brief delays. */
 void
 timer_calibrate (void) 
 {
-  unsigned high_bit, test_bit;
+  uint64_t start_tsc, end_tsc, hz, mult, now;
+  enum intr_level old_level;
+  int64_t start;
+  int shift;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1)) 
+  /* Count TSC cycles from one timer tick to another
+     CALIBRATE_TICKS ticks later.  The ticks are exactly
+     TICK_CYCLES PIT cycles apart. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  start_tsc = rdtsc ();
+  start = ticks;
+  while (ticks < start + CALIBRATE_TICKS)
+    barrier ();
+  end_tsc = rdtsc ();
+  hz = (end_tsc - start_tsc) * PIT_HZ / (CALIBRATE_TICKS * TICK_CYCLES);
+  ASSERT (hz > 0);
+
+  /* Find the largest shift for which the multiplier still fits
+     in 32 bits. */
+  for (shift = 32; shift > 0; shift--) 
     {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
+      mult = ((uint64_t) NSEC_PER_SEC << shift) / hz;
+      if (mult <= UINT32_MAX)
+        break;
     }
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (loops_per_tick | test_bit))
-      loops_per_tick |= test_bit;
+  /* Switch to the new rate without making the clock jump. */
+  old_level = intr_disable ();
+  now = rdtsc ();
+  ns_base += tsc_to_ns (now - tsc_base);
+  tsc_base = now;
+  tsc_mult = mult;
+  tsc_shift = shift;
+  intr_set_level (old_level);
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" TSC cycles/s.\n", hz);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -84,16 +196,32 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since the OS booted,
+   approximately.  Unlike timer_ticks(), it has roughly the
+   resolution of the CPU clock.  It never goes backward, it takes
+   only a few instructions, and it may be called from any
+   context, including with interrupts off and from interrupt
+   handlers. */
+int64_t
+timer_now_ns (void) 
+{
+  return ns_base + tsc_to_ns (rdtsc () - tsc_base);
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The running thread is blocked on sleep_list until
+   timer_interrupt() finds that its wakeup time has arrived, so
+   sleeping threads cost nothing while they sleep. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
-
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  sleep_until ((timer_ticks () + ticks) * TICK_CYCLES);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -159,52 +287,458 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Initializes timer T to call FUNC(AUX) once added. */
+void
+timer_setup (struct timer *t, timer_func *func, void *aux) 
+{
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  t->pending = false;
+  t->func = func;
+  t->aux = aux;
+}
+
+/* Arranges for timer T, which must not be pending, to run once
+   at tick EXPIRES, or at the next tick if EXPIRES has already
+   passed.  May be called from any context. */
+void
+timer_add (struct timer *t, int64_t expires) 
+{
+  timer_add_periodic (t, expires, 0);
+}
+
+/* Arranges for timer T, which must not be pending, to run at
+   tick EXPIRES and then every PERIOD ticks after that until it is
+   canceled.  If PERIOD is 0, T runs only once.  If T's callback
+   runs late, it is not called again to make up for the periods it
+   missed.  May be called from any context. */
+void
+timer_add_periodic (struct timer *t, int64_t expires, int64_t period) 
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL && t->func != NULL);
+  ASSERT (period >= 0);
+
+  old_level = intr_disable ();
+  ASSERT (!t->pending);
+  t->expires = expires;
+  t->period = period;
+  t->pending = true;
+  if (wheel_cnt++ == 0)
+    wheel_time = ticks + 1;
+  wheel_insert (t);
+  if (expires < INT64_MAX / TICK_CYCLES)
+    timer_expedite (expires * TICK_CYCLES);
+  intr_set_level (old_level);
+}
+
+/* Cancels timer T.  Returns true if T was pending, false if it
+   had already run (and was not periodic) or had not been added.
+   Once this returns, T's callback will not be called again,
+   unless it is running right now in the softirq interrupted by
+   the caller.  May be called from any context, including T's own
+   callback. */
+bool
+timer_cancel (struct timer *t) 
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (t != NULL);
+
+  old_level = intr_disable ();
+  was_pending = t->pending;
+  if (was_pending) 
+    {
+      list_remove (&t->elem);
+      t->pending = false;
+      wheel_cnt--;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Returns true if timer T has been added and has not yet run or
+   been canceled.  A periodic timer stays pending until canceled. */
+bool
+timer_pending (const struct timer *t) 
+{
+  return t->pending;
+}
+
+/* Called by the scheduler, with interrupts off, when the CPU
+   stops being idle.  If the PIT was left in one-shot mode for a
+   far-off event, catches up on the ticks that went by and rearms
+   the PIT for the next tick boundary, so that the thread about
+   to run gets its time slices. */
+void
+timer_idle_exit (void) 
+{
+  bool expired;
+  int64_t now;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* If the one-shot has already gone off, its interrupt is
+     pending and will take care of everything. */
+  if (!oneshot)
+    return;
+  pit_read_channel (0, &expired);
+  if (expired)
+    return;
+
+  /* No sleeper or thread_tick() work is due before the one-shot
+     would have gone off, so the ticks that went by were idle. */
+  now = now_cycles ();
+  while ((ticks + 1) * TICK_CYCLES <= now)
+    {
+      ticks++;
+      thread_tick_idle ();
+    }
+  timer_program (now, false);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" interrupts\n",
+          timer_ticks (), intr_cnt);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  thread_tick ();
+  int64_t now;
+
+  intr_cnt++;
+
+  /* In periodic mode, each interrupt is one tick.  In one-shot
+     mode, any number of ticks, including none, may have gone by
+     since the PIT was armed. */
+  now = oneshot ? now_cycles () : (ticks + 1) * TICK_CYCLES;
+  while ((ticks + 1) * TICK_CYCLES <= now)
+    {
+      ticks++;
+      wake_sleepers (ticks * TICK_CYCLES);
+      thread_tick ();
+    }
+  wake_sleepers (now);
+
+  /* Leave timer callbacks to the softirq.  If there are none,
+     keep the wheel in step with the ticks. */
+  if (wheel_cnt > 0)
+    intr_raise_softirq (SOFTIRQ_TIMER);
+  else
+    wheel_time = ticks + 1;
+
+  timer_program (now, thread_cpus_idle ());
+}
+
+/* Timer softirq.  Brings the timer wheel up to date with the
+   ticks, running the timers that expire along the way.  Each
+   callback runs with interrupts on. */
+static void
+timer_softirq (void) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (wheel_time <= ticks && wheel_cnt > 0) 
+    {
+      int64_t tick = wheel_time;
+      struct list *slot = &wheel[0][tick % WHEEL_SIZE];
+      int level;
+
+      /* At the start of each WHEEL_SIZE**L ticks, move the timers
+         due in that span down from level L.  This happens before
+         WHEEL_TIME advances, so that a timer due at TICK itself
+         lands in SLOT instead of being pushed to the next tick. */
+      for (level = 1; level < WHEEL_LEVELS; level++) 
+        {
+          int64_t span = (int64_t) 1 << (WHEEL_BITS * level);
+          if (tick % span != 0)
+            break;
+          wheel_cascade (level, tick);
+        }
+      wheel_time++;
+
+      /* Run the timers in this tick's slot.  Each is popped with
+         interrupts off, so a callback can cancel any timer,
+         including those that are still in the slot. */
+      while (!list_empty (slot)) 
+        {
+          struct timer *t = list_entry (list_pop_front (slot),
+                                        struct timer, elem);
+          if (t->period > 0) 
+            {
+              t->expires += t->period;
+              if (t->expires < wheel_time)
+                t->expires = wheel_time;
+              wheel_insert (t);
+            }
+          else
+            {
+              t->pending = false;
+              wheel_cnt--;
+            }
+
+          intr_enable ();
+          t->func (t->aux);
+          intr_disable ();
+        }
+    }
+  if (wheel_cnt == 0)
+    wheel_time = ticks + 1;
+
+  intr_set_level (old_level);
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool
-too_many_loops (unsigned loops) 
+/* Returns the current time in PIT cycles since boot.  Interrupts
+   must be off. */
+static int64_t
+now_cycles (void) 
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  int64_t start = ticks * TICK_CYCLES + tick_phase;
+  bool expired;
+  unsigned count;
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait (loops);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  count = pit_read_channel (0, &expired);
+  if (oneshot)
+    return start + (expired ? oneshot_len : oneshot_len - count);
+  else
+    {
+      /* In periodic mode the counter runs down from TICK_CYCLES
+         once per tick.  If it has started over since the last
+         timer interrupt was handled, that interrupt is still
+         pending and `ticks' is one behind. */
+      int64_t elapsed = TICK_CYCLES - count;
+      if (intr_is_pending (0x20) && count > TICK_CYCLES / 2)
+        elapsed += TICK_CYCLES;
+      return start + elapsed;
+    }
+}
+
+/* Programs the PIT for the next timer interrupt, given that the
+   time is NOW, in PIT cycles since boot, and whether the CPU is
+   IDLE.  NOW must not be before the start of tick `ticks'.
+   Interrupts must be off. */
+static void
+timer_program (int64_t now, bool idle) 
+{
+  int64_t next_tick = (ticks + 1) * TICK_CYCLES;
+  int64_t deadline = next_tick;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* An idle CPU needs no timer interrupt until a sleeper wakes
+     up, a timer callback is due, or the scheduler has work to
+     do. */
+  if (idle) 
+    {
+      int64_t tick = thread_tick_deadline (ticks);
+      int64_t expiry = wheel_next_expiry ();
+
+      /* Timers due by now are about to run in the softirq. */
+      if (expiry <= ticks)
+        expiry = ticks + 1;
+      if (expiry < tick)
+        tick = expiry;
+      deadline = (tick < INT64_MAX / TICK_CYCLES
+                  ? tick * TICK_CYCLES : INT64_MAX);
+    }
+  if (!list_empty (&sleep_list)) 
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_time < deadline)
+        deadline = t->wakeup_time;
+    }
 
-  /* If the tick count changed, we iterated too long. */
-  barrier ();
-  return start != ticks;
+  tick_phase = now - ticks * TICK_CYCLES;
+  if (deadline == next_tick && tick_phase == 0) 
+    {
+      /* Tick periodically. */
+      if (oneshot)
+        pit_configure_channel (0, 2, TIMER_FREQ);
+      oneshot = false;
+    }
+  else
+    {
+      int64_t len = deadline - now;
+      if (len < 1)
+        len = 1;
+      else if (len > ONESHOT_MAX)
+        len = ONESHOT_MAX;
+      pit_oneshot (0, len);
+      oneshot = true;
+      oneshot_len = len;
+    }
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Wakes up every sleeper whose wakeup time is NOW or earlier.
+   The list is sorted, so we can stop at the first one still
+   asleep. */
+static void
+wake_sleepers (int64_t now) 
+{
+  while (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_time > now)
+        break;
+      list_pop_front (&sleep_list);
+      thread_unblock (t);
+    }
+}
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) 
+/* Puts timer T in its slot in the wheel.  A timer further out
+   than the wheel spans goes in the last slot its level can
+   reach, and moves on from there when that slot cascades.
+   Interrupts must be off. */
+static void
+wheel_insert (struct timer *t) 
 {
-  while (loops-- > 0)
-    barrier ();
+  int64_t expires = t->expires;
+  int64_t delta;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (expires < wheel_time)
+    expires = wheel_time;
+  delta = expires - wheel_time;
+  if (delta >= WHEEL_SPAN)
+    {
+      delta = WHEEL_SPAN - 1;
+      expires = wheel_time + delta;
+    }
+
+  for (level = 0; delta >> (WHEEL_BITS * (level + 1)) != 0; level++)
+    continue;
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                % WHEEL_SIZE],
+                  &t->elem);
+}
+
+/* Moves the timers in the slot of level LEVEL that starts at
+   TICK to where they now belong, which is always a lower level
+   unless the timer is beyond the wheel's span.  Interrupts must
+   be off. */
+static void
+wheel_cascade (int level, int64_t tick) 
+{
+  struct list *slot = &wheel[level][(tick >> (WHEEL_BITS * level))
+                                    % WHEEL_SIZE];
+  struct list timers;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Detach the slot first, since a timer may go back into it. */
+  list_init (&timers);
+  if (!list_empty (slot))
+    list_splice (list_end (&timers), list_begin (slot), list_end (slot));
+  while (!list_empty (&timers))
+    wheel_insert (list_entry (list_pop_front (&timers),
+                              struct timer, elem));
+}
+
+/* Returns the first tick at which the timer softirq has work to
+   do, that is, the tick of the first nonempty level-0 slot or of
+   the first cascade of a nonempty slot in a higher level, or
+   INT64_MAX if the wheel is empty.  Looks at each slot at most
+   once.  Interrupts must be off. */
+static int64_t
+wheel_next_expiry (void) 
+{
+  int64_t next = INT64_MAX;
+  int level, i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (wheel_cnt == 0)
+    return INT64_MAX;
+
+  for (level = 0; level < WHEEL_LEVELS; level++) 
+    {
+      int shift = WHEEL_BITS * level;
+      int64_t span = (int64_t) 1 << shift;
+      int64_t tick = (wheel_time + span - 1) >> shift << shift;
+
+      for (i = 0; i < WHEEL_SIZE && tick < next; i++, tick += span)
+        if (!list_empty (&wheel[level][(tick >> shift) % WHEEL_SIZE]))
+          {
+            next = tick;
+            break;
+          }
+    }
+  return next;
+}
+
+/* Rearms the PIT if WHEN, in PIT cycles since boot, comes
+   before the next timer interrupt, as it may for a new event
+   less than a tick away or while the CPU is idle.  Interrupts
+   must be off. */
+static void
+timer_expedite (int64_t when) 
+{
+  int64_t next_intr = (oneshot
+                       ? ticks * TICK_CYCLES + tick_phase + oneshot_len
+                       : (ticks + 1) * TICK_CYCLES);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (when < next_intr)
+    timer_program (now_cycles (), thread_cpus_idle ());
+}
+
+/* Blocks the running thread on sleep_list until WAKEUP, in PIT
+   cycles since boot, rearming the PIT to interrupt in time if
+   necessary.  Interrupts must be on. */
+static void
+sleep_until (int64_t wakeup) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  old_level = intr_disable ();
+  cur->wakeup_time = wakeup;
+  list_insert_ordered (&sleep_list, &cur->elem, wakeup_less, NULL);
+  timer_expedite (wakeup);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Returns true if the thread owning sleep_list element A wakes
+   up before the one owning B, false otherwise. */
+static bool
+wakeup_less (const struct list_elem *a, const struct list_elem *b,
+             void *aux UNUSED)
+{
+  const struct thread *ta = list_entry (a, struct thread, elem);
+  const struct thread *tb = list_entry (b, struct thread, elem);
+
+  return ta->wakeup_time < tb->wakeup_time;
+}
+
+/* Converts CYCLES of the TSC into nanoseconds.  The 96-bit
+   product CYCLES * TSC_MULT is formed from two 64-bit products,
+   one for each half of CYCLES. */
+static int64_t
+tsc_to_ns (uint64_t cycles) 
+{
+  uint64_t high = (cycles >> 32) * tsc_mult;
+  uint64_t low = (cycles & 0xffffffff) * tsc_mult;
+
+  return (high << (32 - tsc_shift)) + (low >> tsc_shift);
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
@@ -218,8 +752,12 @@ real_time_sleep (int64_t num, int32_t denom)
      1 s / TIMER_FREQ ticks
   */
   int64_t ticks = num * TIMER_FREQ / denom;
+  int64_t end, left;
 
   ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (NSEC_PER_SEC % denom == 0);
+
+  end = timer_now_ns () + num * (NSEC_PER_SEC / denom);
   if (ticks > 0)
     {
       /* We're waiting for at least one full timer tick.  Use
@@ -227,11 +765,18 @@ real_time_sleep (int64_t num, int32_t denom)
          processes. */                
       timer_sleep (ticks); 
     }
-  else 
+
+  /* Sleep off whatever is left until the exact PIT cycle,
+     rearming the PIT in one-shot mode if necessary.  Round up,
+     so that we never sleep too briefly. */
+  left = end - timer_now_ns ();
+  if (left > 0) 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      enum intr_level old_level = intr_disable ();
+      int64_t now = now_cycles ();
+      intr_set_level (old_level);
+
+      sleep_until (now + DIV_ROUND_UP (left * PIT_HZ, NSEC_PER_SEC));
     }
 }
 
@@ -239,8 +784,11 @@ real_time_sleep (int64_t num, int32_t denom)
 static void
 real_time_delay (int64_t num, int32_t denom)
 {
-  /* Scale the numerator and denominator down by 1000 to avoid
-     the possibility of overflow. */
-  ASSERT (denom % 1000 == 0);
-  busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
+  int64_t end;
+
+  ASSERT (NSEC_PER_SEC % denom == 0);
+
+  end = timer_now_ns () + num * (NSEC_PER_SEC / denom);
+  while (timer_now_ns () < end)
+    barrier ();
 }
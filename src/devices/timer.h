@@ -1,17 +1,36 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* Timer callback.  Runs in softirq context, so it may not sleep
+   (see threads/interrupt.c). */
+typedef void timer_func (void *aux);
+
+/* A timer that calls FUNC(AUX) at a given tick, once or
+   periodically.  Initialize with timer_setup(). */
+struct timer
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t expires;            /* Tick at which to call FUNC. */
+    int64_t period;             /* Ticks between calls, or 0 if once. */
+    bool pending;               /* Added and not yet run or canceled? */
+    timer_func *func;           /* Function to call. */
+    void *aux;                  /* Argument for FUNC. */
+  };
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_now_ns (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -24,6 +43,14 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Timer callbacks. */
+void timer_setup (struct timer *, timer_func *, void *aux);
+void timer_add (struct timer *, int64_t expires);
+void timer_add_periodic (struct timer *, int64_t expires, int64_t period);
+bool timer_cancel (struct timer *);
+bool timer_pending (const struct timer *);
+
+void timer_idle_exit (void);
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
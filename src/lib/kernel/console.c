@@ -63,7 +63,7 @@ static int64_t write_cnt;
 void
 console_init (void) 
 {
-  lock_init (&console_lock);
+  lock_init (&console_lock, "console");
   use_console_lock = true;
 }
 
@@ -83,8 +83,10 @@ console_print_stats (void)
   printf ("Console: %lld characters output\n", write_cnt);
 }
 
-/* Acquires the console lock. */
-static void
+/* Acquires the console lock, so that a series of printf()
+   calls by the running thread is not interleaved with output
+   from other threads.  May be nested. */
+void
 acquire_console (void) 
 {
   if (!intr_context () && use_console_lock) 
@@ -97,7 +99,7 @@ acquire_console (void)
 }
 
 /* Releases the console lock. */
-static void
+void
 release_console (void) 
 {
   if (!intr_context () && use_console_lock) 
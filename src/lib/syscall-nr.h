@@ -28,7 +28,20 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_SCHEDSTAT,              /* Print scheduling statistics. */
+    SYS_SETTICKETS,             /* Set stride scheduling tickets. */
+    SYS_SETEDF,                 /* Reserve CPU time as a real-time process. */
+    SYS_SETIDLE,                /* Run only when nothing else is ready. */
+    SYS_LOCKSTAT,               /* Print lock statistics. */
+    SYS_FUTEX_WAIT,             /* Sleep if an int holds a value. */
+    SYS_FUTEX_WAKE,             /* Wake threads sleeping on an int. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT,            /* End the current thread. */
+    SYS_UPTIME                  /* Timer ticks since boot. */
   };
 
 #endif /* lib/syscall-nr.h */
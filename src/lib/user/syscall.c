@@ -182,3 +182,78 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+void
+schedstat (void) 
+{
+  syscall0 (SYS_SCHEDSTAT);
+}
+
+bool
+settickets (int tickets) 
+{
+  return syscall1 (SYS_SETTICKETS, tickets);
+}
+
+bool
+setedf (int runtime, int period) 
+{
+  return syscall2 (SYS_SETEDF, runtime, period);
+}
+
+void
+setidle (bool idle) 
+{
+  syscall1 (SYS_SETIDLE, idle);
+}
+
+void
+lockstat (void) 
+{
+  syscall0 (SYS_LOCKSTAT);
+}
+
+int
+futex_wait (int *addr, int val) 
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, val);
+}
+
+int
+futex_wake (int *addr, int cnt) 
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+/* Where a thread started by thread_create() begins. */
+static void
+thread_start (void (*func) (void *aux), void *aux) 
+{
+  func (aux);
+  thread_exit ();
+}
+
+tid_t
+thread_create (void (*func) (void *aux), void *aux) 
+{
+  return syscall3 (SYS_THREAD_CREATE, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid) 
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (void) 
+{
+  syscall0 (SYS_THREAD_EXIT);
+  NOT_REACHED ();
+}
+
+int
+uptime (void) 
+{
+  return syscall0 (SYS_UPTIME);
+}
@@ -0,0 +1,68 @@
+/* Opens files 10,000 times, keeping a few of them open at once,
+   and reports the average cost of an open and close, in TSC
+   cycles.
+
+   The test cycles through more files than it keeps open, so
+   every open reads a fresh inode, and every close frees one.
+   Each open thus allocates and frees a `struct inode', a `struct
+   file', and a `struct dir' for the root directory.  The kernel's
+   object cache statistics, printed at shutdown, show how much
+   memory those took.
+
+   The check does not grade the numbers. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10             /* Files to cycle through. */
+#define OPEN_CNT 5              /* Files held open at once. */
+#define ITERATIONS 10000        /* Total opens. */
+
+/* Returns the time stamp counter. */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+void
+test_main (void) 
+{
+  char names[FILE_CNT][16];
+  int fds[OPEN_CNT];
+  uint64_t start, cycles;
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      snprintf (names[i], sizeof names[i], "file%d", i);
+      if (!create (names[i], 0))
+        fail ("create \"%s\" failed", names[i]);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  for (i = 0; i < OPEN_CNT; i++)
+    fds[i] = -1;
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      int slot = i % OPEN_CNT;
+
+      if (fds[slot] >= 0)
+        close (fds[slot]);
+      fds[slot] = open (names[i % FILE_CNT]);
+      if (fds[slot] < 2)
+        fail ("open \"%s\" returned %d", names[i % FILE_CNT], fds[slot]);
+    }
+  cycles = rdtsc () - start;
+  for (i = 0; i < OPEN_CNT; i++)
+    close (fds[i]);
+
+  msg ("%d opens: %llu cycles each", ITERATIONS,
+       (unsigned long long) (cycles / ITERATIONS));
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "Missing file creation.\n"
+  if !grep (/^\(open-many\) created \d+ files$/, @output);
+fail "Missing measurement.\n"
+  if !grep (/^\(open-many\) \d+ opens: \d+ cycles each$/, @output);
+fail "Missing exit(0).\n"
+  if !grep (/^open-many: exit\(0\)$/, @output);
+pass;
@@ -0,0 +1,71 @@
+/* Puts 500 threads to sleep at once and measures how much of
+   the sleep window the CPU spends in the idle thread.  Sleeping
+   threads must be blocked, not spinning through the ready
+   queue, so nearly the whole window should be idle time. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of sleeping threads. */
+#define SLEEPER_CNT 500
+
+/* Length of the measured window, in ticks. */
+#define WINDOW_TICKS (2 * TIMER_FREQ)
+
+static thread_func sleeper;
+static int64_t wake_time;
+static struct semaphore done_sema;
+
+void
+test_alarm_idle (void) 
+{
+  int64_t start, end, idle_start, idle_end;
+  int idle_pct;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep %d ticks.", SLEEPER_CNT, WINDOW_TICKS);
+  sema_init (&done_sema, 0);
+  wake_time = timer_ticks () + TIMER_FREQ + WINDOW_TICKS;
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, NULL) == TID_ERROR)
+        fail ("thread_create failed for thread %d", i);
+    }
+
+  /* Give every sleeper a chance to go to sleep, then measure
+     idle time over the window in which all of them sleep. */
+  timer_sleep (wake_time - WINDOW_TICKS - timer_ticks ());
+  start = timer_ticks ();
+  idle_start = thread_get_idle_ticks ();
+  timer_sleep (wake_time - start - 1);
+  end = timer_ticks ();
+  idle_end = thread_get_idle_ticks ();
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done_sema);
+  msg ("All %d sleepers woke up.", SLEEPER_CNT);
+
+  idle_pct = (idle_end - idle_start) * 100 / (end - start);
+  msg ("Idle for %lld of %lld ticks (%d%%).",
+       idle_end - idle_start, end - start, idle_pct);
+  if (idle_pct < 90)
+    fail ("idle thread ran only %d%% of the sleep window", idle_pct);
+}
+
+/* Sleeps until wake_time, then reports back. */
+static void
+sleeper (void *aux UNUSED) 
+{
+  timer_sleep (wake_time - timer_ticks ());
+  sema_up (&done_sema);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "not all sleepers woke up"
+  unless grep ($_ eq '(alarm-idle) All 500 sleepers woke up.', @output);
+
+my ($idle, $window, $pct);
+foreach (@output) {
+    ($idle, $window, $pct) = /Idle for (\d+) of (\d+) ticks \((\d+)%\)/
+      and last;
+}
+fail "missing idle time measurement" unless defined $pct;
+fail "idle for only $pct% of the sleep window" if $pct < 90;
+
+pass;
@@ -0,0 +1,61 @@
+/* Checks that timer_usleep() with less than a tick to sleep
+   really sleeps, letting a lower-priority thread run, and that
+   it wakes up on time rather than at the next tick. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of sleeps, and length of each, in microseconds.  The
+   sleeps add up to 5 ticks at the default TIMER_FREQ. */
+#define SLEEP_CNT 100
+#define SLEEP_US 500
+
+static thread_func spinner;
+static volatile bool done;
+static volatile int64_t spin_cnt;
+static struct semaphore done_sema;
+
+void
+test_alarm_usleep (void) 
+{
+  int64_t start, elapsed;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done_sema, 0);
+  thread_create ("spinner", PRI_DEFAULT - 1, spinner, NULL);
+
+  start = timer_ticks ();
+  for (i = 0; i < SLEEP_CNT; i++)
+    timer_usleep (SLEEP_US);
+  elapsed = timer_elapsed (start);
+
+  done = true;
+  sema_down (&done_sema);
+
+  if (spin_cnt == 0)
+    fail ("lower-priority thread never ran during sub-tick sleeps");
+  msg ("Lower-priority thread ran during sub-tick sleeps.");
+
+  /* Rounding each sleep up to a whole tick would take
+     SLEEP_CNT ticks. */
+  if (elapsed >= SLEEP_CNT / 2)
+    fail ("%d sleeps of %d us took %lld ticks",
+          SLEEP_CNT, SLEEP_US, elapsed);
+  msg ("Sub-tick sleeps took less than a tick each.");
+}
+
+/* Counts as fast as possible until the test is done. */
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!done)
+    spin_cnt++;
+  sema_up (&done_sema);
+}
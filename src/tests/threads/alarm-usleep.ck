@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-usleep) begin
+(alarm-usleep) Lower-priority thread ran during sub-tick sleeps.
+(alarm-usleep) Sub-tick sleeps took less than a tick each.
+(alarm-usleep) end
+EOF
+pass;
@@ -0,0 +1,85 @@
+/* Counts the context switches that it takes to release 64
+   threads waiting on a condition variable with cond_broadcast().
+
+   The main thread broadcasts while holding the lock and then
+   yields, as if it had more work to do under the lock, before
+   releasing it.  If the broadcast woke every waiter, each would
+   run during the yield only to block on the lock, and then run
+   again once the lock came free, for about two switches per
+   waiter.  With wait morphing, the waiters stay blocked until
+   the lock is passed to them, one at a time, for about one
+   switch per waiter.  The check requires fewer than 1.5
+   switches per waiter. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WAITER_CNT 64
+
+static struct lock lock;
+static struct condition cond;
+static struct semaphore done;
+static int waiting_cnt;         /* Threads waiting for GO. */
+static int finished_cnt;        /* Threads past the barrier. */
+static bool go;
+
+static thread_func waiter;
+
+void
+test_cond_barrier (void) 
+{
+  long long start, switches;
+  int i;
+
+  lock_init (&lock, "barrier");
+  cond_init (&cond);
+  sema_init (&done, 0);
+
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, PRI_DEFAULT, waiter, NULL);
+    }
+
+  /* Wait for all the waiters to reach the barrier. */
+  for (;;) 
+    {
+      bool all;
+
+      lock_acquire (&lock);
+      all = waiting_cnt == WAITER_CNT;
+      lock_release (&lock);
+      if (all)
+        break;
+      timer_sleep (1);
+    }
+
+  lock_acquire (&lock);
+  start = thread_get_switch_cnt ();
+  go = true;
+  cond_broadcast (&cond, &lock);
+  thread_yield ();
+  lock_release (&lock);
+  sema_down (&done);
+  switches = thread_get_switch_cnt () - start;
+
+  msg ("%d waiters passed the barrier in %lld context switches.",
+       WAITER_CNT, switches);
+}
+
+static void
+waiter (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  waiting_cnt++;
+  while (!go)
+    cond_wait (&cond, &lock);
+  if (++finished_cnt == WAITER_CNT)
+    sema_up (&done);
+  lock_release (&lock);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my ($waiters, $switches);
+foreach (@output) {
+    ($waiters, $switches) = ($1, $2)
+      if /^\(cond-barrier\) (\d+) waiters passed the barrier in (\d+) context switches\.$/;
+}
+fail "Missing switch count.\n" if !defined ($switches);
+fail "Broadcast to $waiters waiters took $switches context switches, "
+  . "expected fewer than " . 1.5 * $waiters . ".\n"
+  if $switches >= 1.5 * $waiters;
+pass;
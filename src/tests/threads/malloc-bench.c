@@ -0,0 +1,99 @@
+/* Measures the cost, in TSC cycles, of malloc() and free() of
+   64-byte blocks with and without the per-thread magazines.
+
+   "ping-pong" allocates a block and frees it right away.
+   "batch" allocates 32 blocks and then frees them all, which
+   takes more blocks than one magazine holds and so also
+   exercises refilling and draining.  Each result is the cost of
+   one malloc() and free() pair.
+
+   Each measurement is the average over a batch of iterations,
+   and the minimum over several batches is reported, to filter
+   out timer interrupts.  The check requires the magazines to
+   make ping-pong faster. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+#define BATCH_CNT 10
+#define BATCH_SIZE 10000
+#define BLOCK_SIZE 64
+#define BATCH_BLOCKS 32
+
+static void ping_pong (void);
+static void batch (void);
+static uint64_t measure (void (*) (void), int pairs, bool magazines);
+
+void
+test_malloc_bench (void) 
+{
+  uint64_t without, with;
+
+  without = measure (ping_pong, 1, false);
+  with = measure (ping_pong, 1, true);
+  msg ("ping-pong: %"PRIu64" cycles without magazines, "
+       "%"PRIu64" with", without, with);
+
+  without = measure (batch, BATCH_BLOCKS, false);
+  with = measure (batch, BATCH_BLOCKS, true);
+  msg ("batch: %"PRIu64" cycles without magazines, "
+       "%"PRIu64" with", without, with);
+
+  malloc_magazines = true;
+}
+
+/* Returns the smallest average number of cycles per malloc()
+   and free() pair over BATCH_CNT batches of BATCH_SIZE calls of
+   FUNC, each of which makes PAIRS pairs, with the magazines on
+   if MAGAZINES is true. */
+static uint64_t
+measure (void (*func) (void), int pairs, bool magazines) 
+{
+  uint64_t best = UINT64_MAX;
+  int i, j;
+
+  malloc_magazines = magazines;
+  func ();
+  for (i = 0; i < BATCH_CNT; i++) 
+    {
+      uint64_t start = rdtsc ();
+      uint64_t cycles;
+
+      for (j = 0; j < BATCH_SIZE; j++)
+        func ();
+      cycles = (rdtsc () - start) / BATCH_SIZE / pairs;
+      if (cycles < best)
+        best = cycles;
+    }
+  return best;
+}
+
+static void
+ping_pong (void) 
+{
+  void *p = malloc (BLOCK_SIZE);
+  if (p == NULL)
+    fail ("out of memory");
+  free (p);
+}
+
+static void
+batch (void) 
+{
+  void *p[BATCH_BLOCKS];
+  int i;
+
+  for (i = 0; i < BATCH_BLOCKS; i++) 
+    {
+      p[i] = malloc (BLOCK_SIZE);
+      if (p[i] == NULL)
+        fail ("out of memory");
+    }
+  for (i = 0; i < BATCH_BLOCKS; i++)
+    free (p[i]);
+}
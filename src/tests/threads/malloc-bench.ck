@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (%without, %with);
+local ($_);
+foreach (@output) {
+    ($without{$1}, $with{$1}) = ($2, $3)
+      if /^\(malloc-bench\) (ping-pong|batch): (\d+) cycles without magazines, (\d+) with$/;
+}
+foreach my $pattern ("ping-pong", "batch") {
+    fail "Missing $pattern measurement.\n" if !defined $with{$pattern};
+}
+fail "Magazines did not speed up ping-pong: $with{'ping-pong'} cycles "
+  . "with, $without{'ping-pong'} without.\n"
+  if $with{'ping-pong'} >= $without{'ping-pong'};
+pass;
@@ -28,7 +28,7 @@ test_mlfqs_block (void)
   ASSERT (thread_mlfqs);
 
   msg ("Main thread acquiring lock.");
-  lock_init (&lock);
+  lock_init (&lock, "lock");
   lock_acquire (&lock);
   
   msg ("Main thread creating block thread, sleeping 25 seconds...");
@@ -0,0 +1,94 @@
+/* Measures how long the MLFQS's once-per-second recompute keeps
+   interrupts off when there are 1,000 threads.
+
+   The main thread spins reading the time-stamp counter, keeping
+   track of the longest gap between two consecutive readings.
+   Since it is the only runnable thread, every such gap is time
+   spent in the timer interrupt handler.  The longest gap is
+   measured once with only the main and idle threads and once
+   with 1,000 more threads blocked on a semaphore, so that the
+   two numbers show the added per-tick cost. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of extra threads. */
+#define THREAD_CNT 1000
+
+/* Seconds to spin for each measurement. */
+#define SPIN_SECONDS 3
+
+static thread_func blocked_thread;
+static uint64_t longest_stall (void);
+static struct semaphore wait_sema;
+
+void
+test_mlfqs_recompute (void) 
+{
+  uint64_t base_stall, loaded_stall;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  msg ("Measuring longest interrupt stall with no extra threads.");
+  base_stall = longest_stall ();
+
+  msg ("Creating %d threads blocked on a semaphore.", THREAD_CNT);
+  sema_init (&wait_sema, 0);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "blocked %d", i);
+      if (thread_create (name, PRI_DEFAULT, blocked_thread, NULL)
+          == TID_ERROR)
+        fail ("thread_create failed for thread %d", i);
+    }
+
+  msg ("Measuring longest interrupt stall with %d extra threads.",
+       THREAD_CNT);
+  loaded_stall = longest_stall ();
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_up (&wait_sema);
+
+  msg ("Longest stall: %llu cycles with 0 threads, "
+       "%llu cycles with %d threads.",
+       base_stall, loaded_stall, THREAD_CNT);
+}
+
+/* Blocks until the test is done measuring. */
+static void
+blocked_thread (void *aux UNUSED) 
+{
+  sema_down (&wait_sema);
+}
+
+/* Spins for SPIN_SECONDS seconds, starting at a second boundary,
+   and returns the longest gap between consecutive TSC readings,
+   in cycles. */
+static uint64_t
+longest_stall (void) 
+{
+  int64_t start, end;
+  uint64_t prev, longest = 0;
+
+  start = timer_ticks () / TIMER_FREQ * TIMER_FREQ + TIMER_FREQ;
+  end = start + SPIN_SECONDS * TIMER_FREQ;
+  timer_sleep (start - timer_ticks ());
+
+  prev = rdtsc ();
+  while (timer_ticks () < end) 
+    {
+      uint64_t now = rdtsc ();
+      if (now - prev > longest)
+        longest = now - prev;
+      prev = now;
+    }
+  return longest;
+}
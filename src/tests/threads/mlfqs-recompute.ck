@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing stall measurements"
+  unless grep (/Longest stall: \d+ cycles with 0 threads, \d+ cycles with 1000 threads\./, @output);
+
+pass;
@@ -0,0 +1,156 @@
+/* Measures the cost, in TSC cycles, of palloc_get_multiple() and
+   palloc_free_multiple() in the user pool when it is 10%, 50%,
+   and 90% full.
+
+   To reach each level, the test allocates blocks of 1 to 8 pages
+   at random, frees a random half of them, and allocates again,
+   so that the free memory is fragmented as it would be after the
+   pool had been in use for a while.  It then times allocating and
+   immediately freeing another block of 1 to 8 pages, many times
+   over.  With a first-fit scan the cost grows with how full the
+   pool is; with the buddy allocator it should not.
+
+   The check does not grade the numbers. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+
+#define MAX_BLOCK_PAGES 8
+#define ITERATIONS 10000
+
+/* An allocated block. */
+struct block 
+  {
+    void *pages;
+    size_t page_cnt;
+  };
+
+static size_t count_user_pages (void);
+static void run_bench (size_t pool_pages, int percent);
+static size_t fill (struct block *, size_t *block_cnt, size_t used,
+                    size_t target);
+
+void
+test_palloc_bench (void) 
+{
+  size_t pool_pages = count_user_pages ();
+
+  random_init (0);
+  run_bench (pool_pages, 10);
+  run_bench (pool_pages, 50);
+  run_bench (pool_pages, 90);
+}
+
+/* Returns the number of free pages in the user pool. */
+static size_t
+count_user_pages (void) 
+{
+  void *list = NULL;
+  void *page;
+  size_t cnt = 0;
+
+  while ((page = palloc_get_page (PAL_USER)) != NULL) 
+    {
+      *(void **) page = list;
+      list = page;
+      cnt++;
+    }
+  while (list != NULL) 
+    {
+      page = list;
+      list = *(void **) page;
+      palloc_free_page (page);
+    }
+  if (cnt == 0)
+    fail ("user pool is empty");
+  return cnt;
+}
+
+/* Fills the user pool to PERCENT of its POOL_PAGES pages, then
+   reports the average cost of an allocation and of a free. */
+static void
+run_bench (size_t pool_pages, int percent) 
+{
+  size_t target = pool_pages * percent / 100;
+  struct block *blocks;
+  size_t block_cnt = 0;
+  size_t used = 0;
+  uint64_t alloc_cycles = 0, free_cycles = 0;
+  int failures = 0;
+  size_t i, j;
+
+  blocks = malloc (sizeof *blocks * pool_pages);
+  if (blocks == NULL)
+    fail ("out of memory");
+
+  /* Fill, punch holes, and fill again. */
+  used = fill (blocks, &block_cnt, used, target);
+  for (i = j = 0; i < block_cnt; i++)
+    if (random_ulong () % 2)
+      {
+        palloc_free_multiple (blocks[i].pages, blocks[i].page_cnt);
+        used -= blocks[i].page_cnt;
+      }
+    else
+      blocks[j++] = blocks[i];
+  block_cnt = j;
+  used = fill (blocks, &block_cnt, used, target);
+
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      size_t page_cnt = random_ulong () % MAX_BLOCK_PAGES + 1;
+      uint64_t start = rdtsc ();
+      void *pages = palloc_get_multiple (PAL_USER, page_cnt);
+      uint64_t middle = rdtsc ();
+
+      alloc_cycles += middle - start;
+      if (pages == NULL) 
+        {
+          failures++;
+          continue;
+        }
+      palloc_free_multiple (pages, page_cnt);
+      free_cycles += rdtsc () - middle;
+    }
+
+  msg ("%d%% full: %"PRIu64" cycles per allocation, "
+       "%"PRIu64" cycles per free, %d failures",
+       percent, alloc_cycles / ITERATIONS,
+       free_cycles / (ITERATIONS - failures > 0 ? ITERATIONS - failures : 1),
+       failures);
+
+  for (i = 0; i < block_cnt; i++)
+    palloc_free_multiple (blocks[i].pages, blocks[i].page_cnt);
+  free (blocks);
+}
+
+/* Allocates blocks of random sizes from the user pool, adding
+   them to the BLOCK_CNT blocks in BLOCKS, until USED reaches
+   TARGET pages or the pool runs out.  Returns the new number of
+   used pages. */
+static size_t
+fill (struct block *blocks, size_t *block_cnt, size_t used, size_t target) 
+{
+  while (used < target) 
+    {
+      size_t page_cnt = random_ulong () % MAX_BLOCK_PAGES + 1;
+      void *pages;
+
+      if (page_cnt > target - used)
+        page_cnt = target - used;
+      pages = palloc_get_multiple (PAL_USER, page_cnt);
+      if (pages == NULL)
+        break;
+      blocks[*block_cnt].pages = pages;
+      blocks[*block_cnt].page_cnt = page_cnt;
+      ++*block_cnt;
+      used += page_cnt;
+    }
+  return used;
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+foreach my $percent (10, 50, 90) {
+    fail "Missing measurement at $percent% full.\n"
+      if !grep (/^\(palloc-bench\) $percent% full: \d+ cycles per allocation, \d+ cycles per free, \d+ failures$/, @output);
+}
+pass;
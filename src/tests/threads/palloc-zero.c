@@ -0,0 +1,54 @@
+/* Checks that PAL_ZERO pages come back zeroed, whether the idle
+   thread zeroed them ahead of time or not.
+
+   The test dirties a batch of user pages and frees them, sleeps
+   so that the idle thread can zero free pages, and then
+   allocates more PAL_ZERO pages than a pool keeps pre-zeroed, so
+   that some requests are met from the idle thread's pages and
+   the rest are zeroed on the spot.  It does this twice.  The
+   hit and miss counts appear in the statistics printed at
+   shutdown. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 64
+#define ROUNDS 2
+
+void
+test_palloc_zero (void) 
+{
+  uint8_t *pages[PAGE_CNT];
+  int round, i;
+  size_t j;
+
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      timer_sleep (TIMER_FREQ / 10);
+
+      for (i = 0; i < PAGE_CNT; i++) 
+        {
+          pages[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+          if (pages[i] == NULL)
+            fail ("out of user pages after %d pages", i);
+          for (j = 0; j < PGSIZE; j++)
+            if (pages[i][j] != 0)
+              fail ("byte %zu of page %d is %#x, not zero",
+                    j, i, pages[i][j]);
+        }
+
+      /* Dirty the pages, so that the next round's pre-zeroed
+         pages must have been zeroed again. */
+      for (i = 0; i < PAGE_CNT; i++) 
+        {
+          for (j = 0; j < PGSIZE; j++)
+            pages[i][j] = 0xff;
+          palloc_free_page (pages[i]);
+        }
+      msg ("Round %d: %d pages came back zeroed.", round + 1, PAGE_CNT);
+    }
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero) begin
+(palloc-zero) Round 1: 64 pages came back zeroed.
+(palloc-zero) Round 2: 64 pages came back zeroed.
+(palloc-zero) end
+EOF
+pass;
@@ -35,8 +35,8 @@ test_priority_donate_multiple2 (void)
   /* Make sure our priority is the default. */
   ASSERT (thread_get_priority () == PRI_DEFAULT);
 
-  lock_init (&a);
-  lock_init (&b);
+  lock_init (&a, "a");
+  lock_init (&b, "b");
 
   lock_acquire (&a);
   lock_acquire (&b);
@@ -0,0 +1,170 @@
+/* Checks the try variants of reader-writer locks, then compares
+   a reader-writer lock against a plain lock under a mix of 95%
+   reads and 5% writes.
+
+   Eight threads repeatedly pick an operation at random and hold
+   the lock across a one-tick sleep, which stands in for disk
+   I/O done under the lock.  With a plain lock, every operation
+   waits for all the others, so there can be only about one
+   operation per tick.  With a reader-writer lock, reads overlap,
+   so many more operations should complete in the same time.
+   The check requires more than twice as many.
+
+   Each thread also checks that no writer ever shares the lock
+   with another thread. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8
+#define WRITE_PERCENT 5
+#define BENCH_TICKS (3 * TIMER_FREQ)
+
+/* Shared state for one run of the benchmark. */
+struct bench 
+  {
+    bool use_rwlock;            /* Reader-writer lock or plain lock? */
+    struct lock lock;
+    struct rwlock rwlock;
+    volatile bool stop;         /* Set when time is up. */
+    struct semaphore done;      /* Up once per exiting thread. */
+
+    int readers;                /* Threads now reading. */
+    int writers;                /* Threads now writing. */
+    int max_readers;            /* Greatest READERS. */
+    long long ops;              /* Operations completed. */
+  };
+
+static thread_func bench_thread;
+static void try_variants (void);
+static void run_bench (struct bench *, bool use_rwlock);
+
+void
+test_rwlock_bench (void) 
+{
+  struct bench lock_bench, rw_bench;
+
+  try_variants ();
+
+  random_init (0);
+  run_bench (&lock_bench, false);
+  msg ("lock: %lld operations", lock_bench.ops);
+  run_bench (&rw_bench, true);
+  msg ("rwlock: %lld operations, up to %d concurrent readers",
+       rw_bench.ops, rw_bench.max_readers);
+}
+
+/* Checks rwlock_try_acquire_read() and
+   rwlock_try_acquire_write(). */
+static void
+try_variants (void) 
+{
+  struct rwlock rw;
+
+  rwlock_init (&rw, "try");
+  if (!rwlock_try_acquire_read (&rw) || !rwlock_try_acquire_read (&rw))
+    fail ("couldn't take two read locks");
+  if (rwlock_try_acquire_write (&rw))
+    fail ("took write lock while read-locked");
+  rwlock_release_read (&rw);
+  rwlock_release_read (&rw);
+  if (!rwlock_try_acquire_write (&rw))
+    fail ("couldn't take free lock for writing");
+  if (rwlock_try_acquire_read (&rw))
+    fail ("took read lock while write-locked");
+  rwlock_release_write (&rw);
+  msg ("Try variants behaved.");
+}
+
+/* Runs the benchmark in B for BENCH_TICKS ticks. */
+static void
+run_bench (struct bench *b, bool use_rwlock) 
+{
+  int i;
+
+  b->use_rwlock = use_rwlock;
+  lock_init (&b->lock, "bench lock");
+  rwlock_init (&b->rwlock, "bench rwlock");
+  b->stop = false;
+  sema_init (&b->done, 0);
+  b->readers = b->writers = b->max_readers = 0;
+  b->ops = 0;
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "bench %d", i);
+      thread_create (name, PRI_DEFAULT, bench_thread, b);
+    }
+  timer_sleep (BENCH_TICKS);
+  b->stop = true;
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&b->done);
+}
+
+/* Notes that the current thread has started a read (if WRITE is
+   false) or a write (if WRITE is true) in B, and checks that a
+   writer has the lock to itself. */
+static void
+enter (struct bench *b, bool write) 
+{
+  enum intr_level old_level = intr_disable ();
+  if (write)
+    b->writers++;
+  else if (++b->readers > b->max_readers)
+    b->max_readers = b->readers;
+  if (b->writers > 1 || (b->writers > 0 && b->readers > 0))
+    fail ("%d writers and %d readers hold the lock",
+          b->writers, b->readers);
+  intr_set_level (old_level);
+}
+
+/* Notes that the current thread has finished a read or a write
+   in B. */
+static void
+leave (struct bench *b, bool write) 
+{
+  enum intr_level old_level = intr_disable ();
+  if (write)
+    b->writers--;
+  else
+    b->readers--;
+  b->ops++;
+  intr_set_level (old_level);
+}
+
+static void
+bench_thread (void *b_) 
+{
+  struct bench *b = b_;
+
+  while (!b->stop) 
+    {
+      bool write = random_ulong () % 100 < WRITE_PERCENT;
+
+      if (!b->use_rwlock)
+        lock_acquire (&b->lock);
+      else if (write)
+        rwlock_acquire_write (&b->rwlock);
+      else
+        rwlock_acquire_read (&b->rwlock);
+
+      enter (b, write);
+      timer_sleep (1);
+      leave (b, write);
+
+      if (!b->use_rwlock)
+        lock_release (&b->lock);
+      else if (write)
+        rwlock_release_write (&b->rwlock);
+      else
+        rwlock_release_read (&b->rwlock);
+    }
+  sema_up (&b->done);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my ($lock_ops, $rw_ops, $readers);
+local ($_);
+foreach (@output) {
+    $lock_ops = $1 if /^\(rwlock-bench\) lock: (\d+) operations$/;
+    ($rw_ops, $readers) = ($1, $2)
+      if /^\(rwlock-bench\) rwlock: (\d+) operations, up to (\d+) concurrent readers$/;
+}
+fail "Missing benchmark results.\n"
+  if !defined ($lock_ops) || !defined ($rw_ops);
+fail "Readers never held the reader-writer lock at the same time.\n"
+  if $readers < 2;
+fail "Reader-writer lock completed $rw_ops operations, "
+  . "not more than twice the $lock_ops of a plain lock.\n"
+  if $rw_ops <= 2 * $lock_ops;
+pass;
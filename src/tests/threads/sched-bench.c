@@ -0,0 +1,125 @@
+/* Runs the same workload under each scheduling class, as
+   selected on the kernel command line, so that the classes can
+   be compared.
+
+   Three CPU-bound threads holding 100, 200, and 300 tickets spin
+   for 10 seconds, counting the ticks in which they run.  Stride
+   scheduling should give them 1/6, 2/6, and 3/6 of those ticks,
+   that is, about 167, 333, and 500.  The other classes ignore
+   tickets, so they should split the ticks evenly.
+
+   Meanwhile, an interactive thread repeatedly sleeps for a few
+   ticks and totals how late it wakes up, which shows how quickly
+   each class gets a newly woken thread back onto the CPU.  The
+   check does not grade this number. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define HOG_CNT 3
+#define SPIN_START TIMER_FREQ           /* Ticks before spinning. */
+#define SPIN_TICKS (10 * TIMER_FREQ)    /* Ticks to spin for. */
+#define SLEEP_TICKS 5                   /* Interactive sleep length. */
+
+struct hog_info 
+  {
+    int64_t start_time;
+    int tickets;
+    int tick_count;
+  };
+
+struct sleeper_info 
+  {
+    int64_t start_time;
+    int wakeups;
+    int64_t late_ticks;
+  };
+
+static thread_func hog_thread;
+static thread_func sleeper_thread;
+
+void
+test_sched_bench (void) 
+{
+  struct hog_info hogs[HOG_CNT];
+  struct sleeper_info sleeper;
+  int64_t start_time;
+  int i;
+
+  /* Under the MLFQS, keep the main thread from being starved
+     while it starts the other threads. */
+  thread_set_nice (NICE_MIN);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", HOG_CNT + 1);
+  for (i = 0; i < HOG_CNT; i++) 
+    {
+      struct hog_info *h = &hogs[i];
+      char name[16];
+
+      h->start_time = start_time;
+      h->tickets = (i + 1) * TICKETS_DEFAULT;
+      h->tick_count = 0;
+
+      snprintf (name, sizeof name, "hog %d", i);
+      thread_create (name, PRI_DEFAULT, hog_thread, h);
+    }
+  sleeper.start_time = start_time;
+  sleeper.wakeups = 0;
+  sleeper.late_ticks = 0;
+  thread_create ("sleeper", PRI_DEFAULT, sleeper_thread, &sleeper);
+
+  msg ("Sleeping 12 seconds to let threads run, please wait...");
+  timer_sleep (start_time + SPIN_START + SPIN_TICKS + TIMER_FREQ
+               - timer_ticks ());
+
+  for (i = 0; i < HOG_CNT; i++)
+    msg ("Thread %d with %d tickets received %d ticks.",
+         i, hogs[i].tickets, hogs[i].tick_count);
+  msg ("Sleeper woke up %d times, %"PRId64" ticks late in total.",
+       sleeper.wakeups, sleeper.late_ticks);
+}
+
+static void
+hog_thread (void *h_) 
+{
+  struct hog_info *h = h_;
+  int64_t spin_start = h->start_time + SPIN_START;
+  int64_t spin_end = spin_start + SPIN_TICKS;
+  int64_t last_time = 0;
+
+  thread_set_nice (NICE_DEFAULT);
+  thread_set_tickets (h->tickets);
+  timer_sleep (spin_start - timer_ticks ());
+  while (timer_ticks () < spin_end) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        h->tick_count++;
+      last_time = cur_time;
+    }
+}
+
+static void
+sleeper_thread (void *s_) 
+{
+  struct sleeper_info *s = s_;
+  int64_t spin_end = s->start_time + SPIN_START + SPIN_TICKS;
+
+  thread_set_nice (NICE_DEFAULT);
+  timer_sleep (s->start_time + SPIN_START - timer_ticks ());
+  for (;;) 
+    {
+      int64_t wakeup = timer_ticks () + SLEEP_TICKS;
+      if (wakeup > spin_end)
+        break;
+
+      timer_sleep (SLEEP_TICKS);
+      s->wakeups++;
+      s->late_ticks += timer_ticks () - wakeup;
+    }
+}
@@ -0,0 +1,113 @@
+/* Checks the EDF scheduling class.
+
+   A periodic real-time thread that reserves 2 ticks in every 10
+   does about 1 tick of work in each period.  It must finish that
+   work before each deadline, even though a CPU-bound normal
+   thread with a higher priority wants the CPU the whole time.
+
+   A second reservation that would overcommit the CPU must be
+   refused.
+
+   Finally, a real-time thread that reserves 5 ticks in every 10
+   but tries to run all the time must be throttled, so that the
+   normal thread still gets a fair part of the CPU. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define PERIOD 10                       /* Reservation period. */
+#define PERIOD_CNT 20                   /* Periods to run for. */
+#define START_DELAY 10                  /* Ticks before starting. */
+
+/* Shared by the test threads. */
+static int64_t start_time;
+static int missed_cnt;
+static int hog_ticks;
+static int greedy_ticks;
+
+static thread_func periodic_thread;
+static thread_func spin_thread;
+
+void
+test_sched_edf (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Keep the normal thread from starving us while we start the
+     others. */
+  thread_set_priority (PRI_MAX);
+
+  start_time = timer_ticks ();
+  thread_create ("hog", PRI_DEFAULT + 1, spin_thread, &hog_ticks);
+  if (thread_create_edf ("periodic", 2, PERIOD, periodic_thread, NULL)
+      == TID_ERROR)
+    fail ("reservation of 2 ticks every %d refused", PERIOD);
+  if (thread_create_edf ("overcommit", 8, PERIOD, periodic_thread, NULL)
+      != TID_ERROR)
+    fail ("reservation of 8 more ticks every %d admitted", PERIOD);
+  msg ("Overcommitted reservation refused.");
+  if (thread_create_edf ("greedy", 5, PERIOD, spin_thread, &greedy_ticks)
+      == TID_ERROR)
+    fail ("reservation of 5 ticks every %d refused", PERIOD);
+
+  timer_sleep (start_time + START_DELAY + PERIOD_CNT * PERIOD + PERIOD
+               - timer_ticks ());
+
+  if (missed_cnt != 0)
+    fail ("periodic thread missed %d of %d deadlines",
+          missed_cnt, PERIOD_CNT);
+  msg ("Periodic thread met all %d deadlines.", PERIOD_CNT);
+
+  /* Without throttling, the greedy thread would get almost every
+     tick and the hog almost none.  With it, the greedy thread
+     gets about half and the hog most of the rest. */
+  if (greedy_ticks > PERIOD_CNT * PERIOD * 65 / 100
+      || hog_ticks < PERIOD_CNT * PERIOD / 4)
+    fail ("greedy thread got %d ticks, hog got %d ticks",
+          greedy_ticks, hog_ticks);
+  msg ("Overrunning thread was throttled.");
+}
+
+/* Does 1 tick of work at the start of each period, and counts
+   the periods in which the work did not finish by the
+   deadline. */
+static void
+periodic_thread (void *aux UNUSED) 
+{
+  int64_t release = start_time + START_DELAY;
+  int i;
+
+  for (i = 0; i < PERIOD_CNT; i++, release += PERIOD) 
+    {
+      timer_sleep (release - timer_ticks ());
+      while (timer_ticks () <= release)
+        continue;
+      if (timer_ticks () > release + PERIOD)
+        missed_cnt++;
+    }
+}
+
+/* Spins for the whole test, counting the ticks in which it
+   runs in *TICKS_. */
+static void
+spin_thread (void *ticks_) 
+{
+  int *ticks = ticks_;
+  int64_t spin_start = start_time + START_DELAY;
+  int64_t spin_end = spin_start + PERIOD_CNT * PERIOD;
+  int64_t last_time = 0;
+
+  timer_sleep (spin_start - timer_ticks ());
+  while (timer_ticks () < spin_end) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        (*ticks)++;
+      last_time = cur_time;
+    }
+}
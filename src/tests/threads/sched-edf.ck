@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-edf) begin
+(sched-edf) Overcommitted reservation refused.
+(sched-edf) Periodic thread met all 20 deadlines.
+(sched-edf) Overrunning thread was throttled.
+(sched-edf) end
+EOF
+pass;
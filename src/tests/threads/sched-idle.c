@@ -0,0 +1,79 @@
+/* Checks the SCHED_IDLE policy.  A background thread created
+   with thread_create_idle() must not run while even a
+   lowest-priority normal thread is ready, and must get the CPU
+   once no other thread wants it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define START_DELAY 10                  /* Ticks before starting. */
+#define BUSY_TICKS 100                  /* Ticks the normal thread spins. */
+#define FREE_TICKS 50                   /* Ticks the CPU is free after. */
+
+static int64_t start_time;
+static int busy_cnt;                    /* Background ticks while busy. */
+static int free_cnt;                    /* Background ticks while free. */
+
+static thread_func normal_thread;
+static thread_func background_thread;
+
+void
+test_sched_idle (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  start_time = timer_ticks ();
+  thread_create_idle ("background", background_thread, NULL);
+  thread_create ("normal", PRI_MIN, normal_thread, NULL);
+  timer_sleep (start_time + START_DELAY + BUSY_TICKS + FREE_TICKS
+               + START_DELAY - timer_ticks ());
+
+  if (busy_cnt != 0)
+    fail ("background thread ran in %d ticks with a normal thread ready",
+          busy_cnt);
+  msg ("Background thread did not run while a normal thread was ready.");
+  if (free_cnt < FREE_TICKS * 8 / 10)
+    fail ("background thread ran in only %d of %d free ticks",
+          free_cnt, FREE_TICKS);
+  msg ("Background thread ran once the CPU was free.");
+}
+
+/* Spins from the start of the test until BUSY_TICKS later. */
+static void
+normal_thread (void *aux UNUSED) 
+{
+  int64_t spin_start = start_time + START_DELAY;
+
+  timer_sleep (spin_start - timer_ticks ());
+  while (timer_ticks () < spin_start + BUSY_TICKS)
+    continue;
+}
+
+/* Spins from the start of the test until the end of the free
+   time, counting the ticks in which it runs while the normal
+   thread is busy and after it is done. */
+static void
+background_thread (void *aux UNUSED) 
+{
+  int64_t busy_end = start_time + START_DELAY + BUSY_TICKS;
+  int64_t free_end = busy_end + FREE_TICKS;
+  int64_t last_time = 0;
+  int64_t cur_time;
+
+  timer_sleep (start_time + START_DELAY - timer_ticks ());
+  while ((cur_time = timer_ticks ()) < free_end) 
+    {
+      if (cur_time != last_time) 
+        {
+          if (cur_time < busy_end)
+            busy_cnt++;
+          else
+            free_cnt++;
+        }
+      last_time = cur_time;
+    }
+}
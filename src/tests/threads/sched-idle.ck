@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-idle) begin
+(sched-idle) Background thread did not run while a normal thread was ready.
+(sched-idle) Background thread ran once the CPU was free.
+(sched-idle) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Checks that the per-thread scheduling statistics charge time
+   to the right state: sleeping counts as blocked time, waiting
+   behind another thread of the same priority counts as ready
+   time, and spinning counts as running time. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Ticks for the spinner to spin, long enough to use up more
+   than one time slice. */
+#define SPIN_TICKS 10
+
+static thread_func spinner;
+static struct semaphore done_sema;
+
+void
+test_sched_stats (void) 
+{
+  struct thread *cur = thread_current ();
+  uint64_t blocked, ready;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  blocked = cur->blocked_tsc;
+  timer_sleep (10);
+  if (cur->blocked_tsc <= blocked)
+    fail ("blocked time did not grow while sleeping");
+  msg ("Sleeping counted as blocked time.");
+
+  /* The spinner has our priority, so it does not run until we
+     yield, and then we wait in the run queue until it uses up
+     its time slice. */
+  sema_init (&done_sema, 0);
+  ready = cur->ready_tsc;
+  thread_create ("spinner", PRI_DEFAULT, spinner, NULL);
+  thread_yield ();
+  if (cur->ready_tsc <= ready)
+    fail ("ready time did not grow while the spinner ran");
+  msg ("Waiting to run counted as ready time.");
+
+  sema_down (&done_sema);
+}
+
+/* Spins for SPIN_TICKS ticks, being preempted along the way,
+   then checks that it was charged for running. */
+static void
+spinner (void *aux UNUSED) 
+{
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < SPIN_TICKS)
+    continue;
+  if (thread_current ()->run_tsc == 0)
+    fail ("run time did not grow while spinning");
+  msg ("Spinning counted as running time.");
+  sema_up (&done_sema);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-stats) begin
+(sched-stats) Sleeping counted as blocked time.
+(sched-stats) Waiting to run counted as ready time.
+(sched-stats) Spinning counted as running time.
+(sched-stats) end
+EOF
+pass;
@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::threads::mlfqs;
+
+# Checks the output of a sched-bench test.  The tick counts
+# reported by the threads must be in proportion to SHARES, within
+# MAXDIFF ticks.
+sub check_sched_bench {
+    my ($shares, $maxdiff) = @_;
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+
+    my (@actual);
+    my ($total) = 0;
+    my ($sleeper) = 0;
+    local ($_);
+    foreach (@output) {
+	$sleeper = 1 if /Sleeper woke up \d+ times/;
+	my ($id, $count)
+	  = /Thread (\d+) with \d+ tickets received (\d+) ticks\./ or next;
+	$actual[$id] = $count;
+	$total += $count;
+    }
+    fail "Sleeper thread did not report.\n" if !$sleeper;
+
+    my ($share_total) = 0;
+    $share_total += $_ foreach @$shares;
+    my (@expected) = map ($total * $_ / $share_total, @$shares);
+    mlfqs_compare ("thread", "%d",
+		   \@actual, \@expected, $maxdiff, [0, $#$shares, 1],
+		   "Some tick counts were missing or differed from those "
+		   . "expected by more than $maxdiff.");
+    pass;
+}
+
+1;
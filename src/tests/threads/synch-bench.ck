@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+foreach my $pair ("sema_down/sema_up", "lock_acquire/lock_release",
+		  "intr_disable/intr_set_level") {
+    fail "Missing $pair measurement.\n"
+      if !grep (/^\(synch-bench\) \Q$pair\E: \d+ cycles$/, @output);
+}
+pass;
@@ -17,6 +17,8 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-idle", test_alarm_idle},
+    {"alarm-usleep", test_alarm_usleep},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -29,6 +31,24 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"sched-stats", test_sched_stats},
+    {"timer-ns", test_timer_ns},
+    {"timer-wheel", test_timer_wheel},
+    {"workqueue", test_workqueue},
+    {"rwlock-bench", test_rwlock_bench},
+    {"synch-bench", test_synch_bench},
+    {"cond-barrier", test_cond_barrier},
+    {"timed-wait", test_timed_wait},
+    {"palloc-bench", test_palloc_bench},
+    {"malloc-bench", test_malloc_bench},
+    {"vmalloc", test_vmalloc},
+    {"palloc-zero", test_palloc_zero},
+    {"sched-bench-rr", test_sched_bench},
+    {"sched-bench-priority", test_sched_bench},
+    {"sched-bench-mlfqs", test_sched_bench},
+    {"sched-bench-stride", test_sched_bench},
+    {"sched-edf", test_sched_edf},
+    {"sched-idle", test_sched_idle},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +58,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-recompute", test_mlfqs_recompute},
   };
 
 static const char *test_name;
@@ -11,6 +11,8 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_idle;
+extern test_func test_alarm_usleep;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -23,6 +25,21 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_sched_stats;
+extern test_func test_timer_ns;
+extern test_func test_timer_wheel;
+extern test_func test_workqueue;
+extern test_func test_rwlock_bench;
+extern test_func test_synch_bench;
+extern test_func test_cond_barrier;
+extern test_func test_timed_wait;
+extern test_func test_palloc_bench;
+extern test_func test_malloc_bench;
+extern test_func test_vmalloc;
+extern test_func test_palloc_zero;
+extern test_func test_sched_bench;
+extern test_func test_sched_edf;
+extern test_func test_sched_idle;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +49,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_recompute;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
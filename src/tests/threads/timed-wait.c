@@ -0,0 +1,103 @@
+/* Checks sema_down_timeout(), cond_timedwait(), and
+   lock_acquire_timeout(): each must time out when nothing
+   happens, succeed when woken in time, and, for locks, withdraw
+   the priority donated by a thread that gives up. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static struct semaphore sema;
+static struct lock lock;
+static struct condition cond;
+
+static thread_func sema_upper;
+static thread_func cond_signaler;
+static thread_func lock_waiter;
+
+static const char *
+timing (int64_t start, int64_t ticks) 
+{
+  return timer_elapsed (start) >= ticks ? "after timeout" : "before timeout";
+}
+
+void
+test_timed_wait (void) 
+{
+  int64_t start;
+  bool ok;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Semaphores. */
+  sema_init (&sema, 0);
+  start = timer_ticks ();
+  ok = sema_down_timeout (&sema, 5);
+  msg ("sema_down_timeout, no up: %s %s",
+       ok ? "downed" : "timed out", timing (start, 5));
+
+  thread_create ("sema-upper", PRI_DEFAULT + 1, sema_upper, NULL);
+  start = timer_ticks ();
+  ok = sema_down_timeout (&sema, 1000);
+  msg ("sema_down_timeout, up after 2 ticks: %s %s",
+       ok ? "downed" : "timed out", timing (start, 1000));
+
+  /* Condition variables. */
+  lock_init (&lock, "timed-wait");
+  cond_init (&cond);
+  lock_acquire (&lock);
+  start = timer_ticks ();
+  ok = cond_timedwait (&cond, &lock, 5);
+  msg ("cond_timedwait, no signal: %s %s",
+       ok ? "signaled" : "timed out", timing (start, 5));
+
+  thread_create ("cond-signaler", PRI_DEFAULT + 1, cond_signaler, NULL);
+  start = timer_ticks ();
+  ok = cond_timedwait (&cond, &lock, 1000);
+  msg ("cond_timedwait, signal after 2 ticks: %s %s",
+       ok ? "signaled" : "timed out", timing (start, 1000));
+
+  /* Locks.  We still hold LOCK. */
+  thread_create ("lock-waiter", PRI_DEFAULT + 1, lock_waiter, NULL);
+  msg ("Priority while lock-waiter waits: %d", thread_get_priority ());
+  timer_sleep (10);
+  msg ("Priority after lock-waiter gives up: %d", thread_get_priority ());
+  lock_release (&lock);
+
+  ok = lock_acquire_timeout (&lock, 5);
+  msg ("lock_acquire_timeout, lock free: %s",
+       ok ? "acquired" : "timed out");
+  lock_release (&lock);
+}
+
+static void
+sema_upper (void *aux UNUSED) 
+{
+  timer_sleep (2);
+  sema_up (&sema);
+}
+
+static void
+cond_signaler (void *aux UNUSED) 
+{
+  timer_sleep (2);
+  lock_acquire (&lock);
+  cond_signal (&cond, &lock);
+  lock_release (&lock);
+}
+
+static void
+lock_waiter (void *aux UNUSED) 
+{
+  int64_t start = timer_ticks ();
+  bool ok = lock_acquire_timeout (&lock, 5);
+
+  msg ("lock_acquire_timeout, lock held: %s %s",
+       ok ? "acquired" : "timed out", timing (start, 5));
+  if (ok)
+    lock_release (&lock);
+}
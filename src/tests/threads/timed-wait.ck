@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timed-wait) begin
+(timed-wait) sema_down_timeout, no up: timed out after timeout
+(timed-wait) sema_down_timeout, up after 2 ticks: downed before timeout
+(timed-wait) cond_timedwait, no signal: timed out after timeout
+(timed-wait) cond_timedwait, signal after 2 ticks: signaled before timeout
+(timed-wait) Priority while lock-waiter waits: 32
+(timed-wait) lock_acquire_timeout, lock held: timed out after timeout
+(timed-wait) Priority after lock-waiter gives up: 31
+(timed-wait) lock_acquire_timeout, lock free: acquired
+(timed-wait) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Checks timer_now_ns(): it must never go backward, it must
+   agree with timer_ticks() over a long sleep, and brief delays
+   and sleeps measured with it must last as long as requested. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of back-to-back clock readings to compare. */
+#define READ_CNT 100000
+
+/* Ticks to sleep when comparing against timer_ticks(). */
+#define SLEEP_TICKS 50
+
+void
+test_timer_ns (void) 
+{
+  int64_t prev, start, elapsed, expected;
+  int i;
+
+  prev = timer_now_ns ();
+  for (i = 0; i < READ_CNT; i++) 
+    {
+      int64_t now = timer_now_ns ();
+      if (now < prev)
+        fail ("clock went backward from %lld to %lld ns", prev, now);
+      prev = now;
+    }
+  msg ("Clock never went backward.");
+
+  /* Sleeping SLEEP_TICKS ticks from partway through a tick lasts
+     between SLEEP_TICKS - 1 and SLEEP_TICKS ticks. */
+  start = timer_now_ns ();
+  timer_sleep (SLEEP_TICKS);
+  elapsed = timer_now_ns () - start;
+  expected = (int64_t) SLEEP_TICKS * 1000000000 / TIMER_FREQ;
+  if (elapsed < expected * 9 / 10 || elapsed > expected * 11 / 10)
+    fail ("%d-tick sleep took %lld ns, expected about %lld",
+          SLEEP_TICKS, elapsed, expected);
+  msg ("Clock agrees with timer ticks.");
+
+  start = timer_now_ns ();
+  timer_udelay (1000);
+  elapsed = timer_now_ns () - start;
+  if (elapsed < 1000000)
+    fail ("1000 us delay took only %lld ns", elapsed);
+  msg ("Delay lasted long enough.");
+
+  /* Allow for slight disagreement between the PIT, which times
+     the sleep, and the TSC, which measures it. */
+  start = timer_now_ns ();
+  timer_usleep (2500);
+  elapsed = timer_now_ns () - start;
+  if (elapsed < 2500000 * 99 / 100)
+    fail ("2500 us sleep took only %lld ns", elapsed);
+  msg ("Sleep lasted long enough.");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timer-ns) begin
+(timer-ns) Clock never went backward.
+(timer-ns) Clock agrees with timer ticks.
+(timer-ns) Delay lasted long enough.
+(timer-ns) Sleep lasted long enough.
+(timer-ns) end
+EOF
+pass;
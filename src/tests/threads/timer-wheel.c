@@ -0,0 +1,185 @@
+/* Adds 10,000 one-shot timers spread over several seconds,
+   cancels a quarter of them, and checks that every remaining
+   timer runs exactly once, never early and at most a few ticks
+   late, and that no canceled timer runs.  Also checks that
+   timers due exactly at the start of a level-1 slot, which reach
+   level 0 by cascading, run at exactly their tick; that a
+   periodic timer runs at its period until it cancels itself; and
+   that timers far enough out to land in a high level of the
+   wheel can be canceled. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <round.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of one-shot timers, and the span of ticks over which
+   they expire.  The span starts a second out, to leave time to
+   cancel timers before any of them expires. */
+#define TIMER_CNT 10000
+#define SPAN_START TIMER_FREQ
+#define SPAN_TICKS (6 * TIMER_FREQ)
+
+/* Allowed lateness, in ticks. */
+#define MAX_LATE 5
+
+/* Periodic timer's period and number of runs. */
+#define PERIOD 7
+#define PERIODIC_RUNS 10
+
+/* Number of far-off timers. */
+#define FAR_CNT 10
+
+/* Number of timers due on a multiple of the level-0 span, which
+   is 64 ticks. */
+#define BOUNDARY_CNT 8
+#define BOUNDARY_SPAN 64
+
+struct test_timer 
+  {
+    struct timer timer;
+    bool canceled;              /* Canceled by the test? */
+    int runs;                   /* Number of times the callback ran. */
+  };
+
+static timer_func record_run;
+static timer_func record_exact;
+static timer_func periodic_run;
+
+static int bad_cnt;             /* Runs early or too late. */
+static int periodic_runs;
+static int64_t periodic_last;
+static struct timer periodic;
+static int64_t boundary_ran[BOUNDARY_CNT];
+
+void
+test_timer_wheel (void) 
+{
+  struct test_timer *timers;
+  struct timer far[FAR_CNT];
+  struct timer boundary[BOUNDARY_CNT];
+  int64_t start, first_boundary;
+  int ran_cnt, i;
+
+  timers = malloc (sizeof *timers * TIMER_CNT);
+  if (timers == NULL)
+    PANIC ("couldn't allocate timers");
+
+  random_init (0);
+  start = timer_ticks ();
+  for (i = 0; i < TIMER_CNT; i++) 
+    {
+      struct test_timer *t = &timers[i];
+      t->canceled = false;
+      t->runs = 0;
+      timer_setup (&t->timer, record_run, t);
+      timer_add (&t->timer,
+                 start + SPAN_START + random_ulong () % SPAN_TICKS);
+    }
+  for (i = 0; i < TIMER_CNT; i += 4) 
+    {
+      timers[i].canceled = timer_cancel (&timers[i].timer);
+      if (!timers[i].canceled)
+        fail ("timer %d ran before it could be canceled", i);
+    }
+  msg ("Added %d timers and canceled every fourth.", TIMER_CNT);
+
+  periodic_runs = 0;
+  periodic_last = start;
+  timer_setup (&periodic, periodic_run, NULL);
+  timer_add_periodic (&periodic, start + PERIOD, PERIOD);
+
+  for (i = 0; i < FAR_CNT; i++) 
+    {
+      timer_setup (&far[i], record_run, NULL);
+      timer_add (&far[i], start + 100 * TIMER_FREQ + i);
+    }
+  for (i = 0; i < FAR_CNT; i++)
+    if (!timer_cancel (&far[i]))
+      fail ("far-off timer %d was not pending", i);
+  msg ("Canceled %d far-off timers.", FAR_CNT);
+
+  /* Each of these is more than a level-0 span away when added,
+     so it starts out in level 1. */
+  first_boundary = ROUND_UP (start + SPAN_START, BOUNDARY_SPAN);
+  for (i = 0; i < BOUNDARY_CNT; i++) 
+    {
+      boundary_ran[i] = -1;
+      timer_setup (&boundary[i], record_exact, &boundary_ran[i]);
+      timer_add (&boundary[i], first_boundary + i * BOUNDARY_SPAN);
+    }
+
+  timer_sleep (start + SPAN_START + SPAN_TICKS + MAX_LATE
+               - timer_ticks ());
+
+  ran_cnt = 0;
+  for (i = 0; i < TIMER_CNT; i++) 
+    {
+      struct test_timer *t = &timers[i];
+      if (t->canceled && t->runs != 0)
+        fail ("canceled timer %d ran", i);
+      else if (!t->canceled && t->runs != 1)
+        fail ("timer %d ran %d times", i, t->runs);
+      ran_cnt += t->runs;
+    }
+  if (bad_cnt != 0)
+    fail ("%d timers ran early or more than %d ticks late",
+          bad_cnt, MAX_LATE);
+  msg ("%d timers ran once each, on time.", ran_cnt);
+
+  if (periodic_runs != PERIODIC_RUNS || timer_pending (&periodic))
+    fail ("periodic timer ran %d times", periodic_runs);
+  msg ("Periodic timer ran %d times.", PERIODIC_RUNS);
+
+  for (i = 0; i < BOUNDARY_CNT; i++)
+    if (boundary_ran[i] != first_boundary + i * BOUNDARY_SPAN)
+      fail ("timer due at tick %"PRId64" ran at tick %"PRId64,
+            first_boundary + i * BOUNDARY_SPAN, boundary_ran[i]);
+  msg ("%d timers due on a %d-tick boundary ran on time.",
+       BOUNDARY_CNT, BOUNDARY_SPAN);
+
+  free (timers);
+}
+
+/* Records a run of the test_timer AUX. */
+static void
+record_run (void *t_) 
+{
+  struct test_timer *t = t_;
+  int64_t now = timer_ticks ();
+
+  if (t == NULL)
+    return;
+  if (now < t->timer.expires || now > t->timer.expires + MAX_LATE)
+    bad_cnt++;
+  t->runs++;
+}
+
+/* Records in the int64_t that AUX points to the tick on which a
+   boundary timer ran. */
+static void
+record_exact (void *ran_) 
+{
+  int64_t *ran = ran_;
+
+  *ran = timer_ticks ();
+}
+
+/* Counts runs of the periodic timer, checking the spacing
+   between them, and cancels it after PERIODIC_RUNS runs. */
+static void
+periodic_run (void *aux UNUSED) 
+{
+  int64_t now = timer_ticks ();
+
+  if (now - periodic_last < PERIOD || now - periodic_last > PERIOD + MAX_LATE)
+    bad_cnt++;
+  periodic_last = now;
+  if (++periodic_runs == PERIODIC_RUNS)
+    timer_cancel (&periodic);
+}
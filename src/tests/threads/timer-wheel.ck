@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timer-wheel) begin
+(timer-wheel) Added 10000 timers and canceled every fourth.
+(timer-wheel) Canceled 10 far-off timers.
+(timer-wheel) 7500 timers ran once each, on time.
+(timer-wheel) Periodic timer ran 10 times.
+(timer-wheel) 8 timers due on a 64-tick boundary ran on time.
+(timer-wheel) end
+EOF
+pass;
@@ -0,0 +1,100 @@
+/* Checks vmalloc() and vfree(), then checks that malloc() can
+   still allocate a big block when the kernel pool is too
+   fragmented to have a run of free pages that long.
+
+   To fragment the pool, the test takes every free kernel page
+   and then gives back the ones with even page numbers, so that
+   no two free pages are adjacent. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+#define BIG_PAGES 8
+
+static void check_pattern (uint8_t *, size_t size, uint8_t seed);
+
+void
+test_vmalloc (void) 
+{
+  void *list = NULL, *kept = NULL;
+  void *page;
+  uint8_t *p;
+  size_t size = BIG_PAGES * PGSIZE;
+  int cnt, free_cnt;
+
+  /* Plain vmalloc() and vfree(). */
+  p = vmalloc (size);
+  if (p == NULL)
+    fail ("vmalloc() of %zu bytes failed", size);
+  if (!is_vmalloc_vaddr (p) || pg_ofs (p) != 0)
+    fail ("vmalloc() returned %p", p);
+  check_pattern (p, size, 1);
+  vfree (p);
+  msg ("vmalloc() and vfree() work.");
+
+  /* Take every free kernel page, then give back every other one. */
+  cnt = 0;
+  while ((page = palloc_get_page (0)) != NULL) 
+    {
+      *(void **) page = list;
+      list = page;
+      cnt++;
+    }
+  free_cnt = 0;
+  while (list != NULL) 
+    {
+      page = list;
+      list = *(void **) page;
+      if (pg_no (page) % 2 == 0) 
+        {
+          palloc_free_page (page);
+          free_cnt++;
+        }
+      else 
+        {
+          *(void **) page = kept;
+          kept = page;
+        }
+    }
+  if (palloc_get_multiple (0, 2) != NULL)
+    fail ("kernel pool still has 2 contiguous free pages");
+  msg ("Fragmented the kernel pool.");
+
+  /* A big malloc() must still succeed. */
+  p = malloc (size);
+  if (p == NULL)
+    fail ("malloc() of %zu bytes failed with %d of %d pages free",
+          size, free_cnt, cnt);
+  if (!is_vmalloc_vaddr (p))
+    fail ("malloc() of %zu bytes did not use vmalloc()", size);
+  check_pattern (p, size, 2);
+  free (p);
+  msg ("malloc() of %zu bytes succeeded.", size);
+
+  while (kept != NULL) 
+    {
+      page = kept;
+      kept = *(void **) page;
+      palloc_free_page (page);
+    }
+}
+
+/* Fills the SIZE bytes at P with a pattern based on SEED, then
+   checks that the pattern reads back. */
+static void
+check_pattern (uint8_t *p, size_t size, uint8_t seed) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = seed + i * 7;
+  for (i = 0; i < size; i++)
+    if (p[i] != (uint8_t) (seed + i * 7))
+      fail ("byte %zu of %p is wrong", i, p);
+}
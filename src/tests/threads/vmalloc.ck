@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vmalloc) begin
+(vmalloc) vmalloc() and vfree() work.
+(vmalloc) Fragmented the kernel pool.
+(vmalloc) malloc() of 32768 bytes succeeded.
+(vmalloc) end
+EOF
+pass;
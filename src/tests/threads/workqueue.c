@@ -0,0 +1,112 @@
+/* Checks that a workqueue runs queued items in order of
+   priority, FIFO among equal priorities; that a pending item
+   cannot be queued twice; that canceled items do not run; that
+   delayed items run no earlier than their delay; and that
+   work_flush() waits for an item to finish. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+/* Number of prioritized items. */
+#define ITEM_CNT 5
+
+/* Delay for delayed work, in ticks. */
+#define DELAY 10
+
+static work_func gate_work;
+static work_func record_work;
+static work_func delayed_work;
+
+static struct semaphore gate;
+static int order[ITEM_CNT];
+static int order_cnt;
+static int64_t delayed_ran;
+
+void
+test_workqueue (void) 
+{
+  static const int priorities[ITEM_CNT] = {1, 3, 2, 3, 1};
+  static const int expected[] = {1, 3, 2, 0};
+  struct workqueue *wq;
+  struct work gate_item, items[ITEM_CNT], delayed, far;
+  int64_t start;
+  int i;
+
+  wq = workqueue_create ("test-wq", 1, PRI_DEFAULT);
+  if (wq == NULL)
+    fail ("couldn't create workqueue");
+
+  /* Hold up the only worker, so that the other items pile up
+     in the queue.  The gate item has the highest priority, so
+     it runs first even if the worker has not taken it yet. */
+  sema_init (&gate, 0);
+  work_init (&gate_item, gate_work, NULL, 10);
+  work_queue (wq, &gate_item);
+  for (i = 0; i < ITEM_CNT; i++) 
+    {
+      work_init (&items[i], record_work, (void *) i, priorities[i]);
+      if (!work_queue (wq, &items[i]))
+        fail ("couldn't queue item %d", i);
+    }
+  if (work_queue (wq, &items[0]))
+    fail ("queued pending item twice");
+  if (!work_cancel (&items[4]))
+    fail ("couldn't cancel pending item");
+  msg ("Queued %d items and canceled one.", ITEM_CNT);
+
+  sema_up (&gate);
+  workqueue_flush (wq);
+  if (order_cnt != ITEM_CNT - 1)
+    fail ("%d items ran, expected %d", order_cnt, ITEM_CNT - 1);
+  for (i = 0; i < order_cnt; i++)
+    if (order[i] != expected[i])
+      fail ("item %d ran in position %d, expected item %d",
+            order[i], i, expected[i]);
+  msg ("Items ran in order of priority.");
+
+  work_init (&delayed, delayed_work, NULL, 0);
+  start = timer_ticks ();
+  work_queue_delayed (wq, &delayed, DELAY);
+  work_flush (&delayed);
+  if (delayed_ran < start + DELAY)
+    fail ("delayed item ran %"PRId64" ticks early",
+          start + DELAY - delayed_ran);
+  msg ("Delayed item ran after its delay.");
+
+  work_init (&far, delayed_work, NULL, 0);
+  delayed_ran = 0;
+  work_queue_delayed (wq, &far, 100 * TIMER_FREQ);
+  if (!work_cancel (&far))
+    fail ("couldn't cancel delayed item");
+  work_flush (&far);
+  if (delayed_ran != 0)
+    fail ("canceled delayed item ran");
+  msg ("Canceled delayed item did not run.");
+}
+
+/* Blocks the worker until the test opens the gate. */
+static void
+gate_work (void *aux UNUSED) 
+{
+  sema_down (&gate);
+}
+
+/* Records that item AUX ran. */
+static void
+record_work (void *aux) 
+{
+  order[order_cnt++] = (int) aux;
+}
+
+/* Records when the delayed item ran. */
+static void
+delayed_work (void *aux UNUSED) 
+{
+  delayed_ran = timer_ticks ();
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) Queued 5 items and canceled one.
+(workqueue) Items ran in order of priority.
+(workqueue) Delayed item ran after its delay.
+(workqueue) Canceled delayed item did not run.
+(workqueue) end
+EOF
+pass;
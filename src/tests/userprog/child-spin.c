@@ -0,0 +1,19 @@
+/* Child process run by smp-bench.
+   Spins on the CPU for a fixed amount of work and terminates. */
+
+#include "tests/lib.h"
+
+const char *test_name = "child-spin";
+
+#define SPIN_ITERATIONS 20000000
+
+int
+main (void) 
+{
+  volatile unsigned sum = 0;
+  unsigned i;
+
+  for (i = 0; i < SPIN_ITERATIONS; i++)
+    sum += i;
+  return 0;
+}
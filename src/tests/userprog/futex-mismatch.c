@@ -0,0 +1,16 @@
+/* Calls futex_wait() with a value that the futex does not hold,
+   which must return -1 without sleeping, and futex_wake() on a
+   futex with no waiters, which must wake no one. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int futex = 1;
+
+void
+test_main (void) 
+{
+  msg ("futex_wait(&futex, 0): %d", futex_wait (&futex, 0));
+  msg ("futex_wake(&futex, 1): %d", futex_wake (&futex, 1));
+}
@@ -0,0 +1,38 @@
+/* Executes and waits for a child process 100,000 times in a row.
+   Each exited child must give back all of its kernel memory, or
+   the kernel pool runs dry long before the last exec. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* Number of children to run. */
+#define CHILD_CNT 100000
+
+/* Exit code of each child. */
+#define CHILD_EXIT 42
+
+const char *test_name = "exec-many";
+
+int
+main (int argc, char *argv[] UNUSED) 
+{
+  int i;
+
+  /* Children just exit. */
+  if (argc > 1)
+    return CHILD_EXIT;
+
+  msg ("begin");
+  for (i = 0; i < CHILD_CNT; i++) 
+    {
+      pid_t pid = exec ("exec-many child");
+      if (pid == PID_ERROR)
+        fail ("exec failed after %d children", i);
+      if (wait (pid) != CHILD_EXIT)
+        fail ("wrong exit code after %d children", i);
+    }
+  msg ("ran %d children", CHILD_CNT);
+  msg ("end");
+  return 0;
+}
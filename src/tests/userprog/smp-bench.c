@@ -0,0 +1,50 @@
+/* Runs 1, 2, 3, and then 4 CPU-bound child processes at once
+   and reports how many timer ticks each round takes, next to
+   the time that running the same children one after another
+   would take, estimated from the first round.
+
+   User code runs on all CPUs in parallel, so under "pintos
+   --smp=4" every round should take about as long as the first,
+   whereas on one CPU the time grows with the number of
+   children.  Kernel code is still serialized by the kernel lock,
+   so exec and wait do not scale.
+
+   The check fails unless the 4-process round takes at most half
+   as long as running its children serially would. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_CHILDREN 4
+
+void
+test_main (void) 
+{
+  int serial_ticks = 0;
+  int n;
+
+  for (n = 1; n <= MAX_CHILDREN; n++) 
+    {
+      pid_t children[MAX_CHILDREN];
+      int start, ticks;
+      int i;
+
+      start = uptime ();
+      for (i = 0; i < n; i++) 
+        {
+          children[i] = exec ("child-spin");
+          if (children[i] == PID_ERROR)
+            fail ("exec child-spin failed");
+        }
+      for (i = 0; i < n; i++)
+        if (wait (children[i]) != 0)
+          fail ("child-spin failed");
+      ticks = uptime () - start;
+
+      if (n == 1)
+        serial_ticks = ticks;
+      msg ("%d processes: %d ticks, %d ticks serially", n, ticks,
+           serial_ticks * n);
+    }
+}
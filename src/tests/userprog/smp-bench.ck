@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (%ticks, %serial);
+foreach my $n (1..4) {
+    foreach (@output) {
+	($ticks{$n}, $serial{$n})
+	  = /^\(smp-bench\) $n processes: (\d+) ticks, (\d+) ticks serially$/
+	  and last;
+    }
+    fail "Missing measurement for $n processes.\n"
+      unless defined $serial{$n};
+}
+
+# The test runs with 4 CPUs, so 4 CPU-bound children should finish
+# in well under the time they would take one after another.  Allow
+# for exec and wait, which the kernel lock serializes, by asking
+# for only half the ideal speedup.
+fail "4 processes took $ticks{4} ticks, "
+  . "more than half of the $serial{4} they would take serially\n"
+  if $ticks{4} * 2 > $serial{4};
+pass;
@@ -0,0 +1,95 @@
+/* Several threads of this process increment a shared counter
+   under a mutex built on futex_wait() and futex_wake(), with a
+   critical section long enough that timer interrupts often
+   preempt a thread holding the mutex.  No increment may be
+   lost.
+
+   The mutex is the three-state one from Drepper's "Futexes Are
+   Tricky": 0 if unlocked, 1 if locked without waiters, 2 if
+   locked with possible waiters.  Locking and unlocking make no
+   system calls unless the mutex is contended. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITER_CNT 200
+
+static int mutex;
+static int counter;
+
+/* Atomically sets *P to NEW if it equals OLD.  Returns the old
+   value of *P. */
+static int
+cmpxchg (int *p, int old, int new) 
+{
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "+a" (old), "+m" (*p) : "r" (new) : "memory");
+  return old;
+}
+
+/* Atomically sets *P to NEW and returns its old value. */
+static int
+xchg (int *p, int new) 
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+static void
+mutex_lock (int *m) 
+{
+  int c = cmpxchg (m, 0, 1);
+
+  if (c != 0) 
+    {
+      if (c != 2)
+        c = xchg (m, 2);
+      while (c != 0) 
+        {
+          futex_wait (m, 2);
+          c = xchg (m, 2);
+        }
+    }
+}
+
+static void
+mutex_unlock (int *m) 
+{
+  if (xchg (m, 0) == 2)
+    futex_wake (m, 1);
+}
+
+static void
+increment (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      volatile int j;
+      int value;
+
+      mutex_lock (&mutex);
+      value = counter;
+      for (j = 0; j < 1000; j++)
+        continue;
+      counter = value + 1;
+      mutex_unlock (&mutex);
+    }
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (increment, NULL)) != TID_ERROR,
+           "create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "join thread %d", i);
+  msg ("counter: %d", counter);
+}
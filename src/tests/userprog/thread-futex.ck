@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-futex) begin
+(thread-futex) create thread 0
+(thread-futex) create thread 1
+(thread-futex) create thread 2
+(thread-futex) create thread 3
+(thread-futex) join thread 0
+(thread-futex) join thread 1
+(thread-futex) join thread 2
+(thread-futex) join thread 3
+(thread-futex) counter: 800
+(thread-futex) end
+thread-futex: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Starts several threads in this process, each of which sums a
+   slice of a range into a shared array, and joins them.  The
+   threads share our address space, so their sums must be
+   visible once they have been joined.  A thread can be joined
+   only once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define SLICE 1000
+
+static int sums[THREAD_CNT];
+
+static void
+sum_slice (void *aux) 
+{
+  int n = (int) aux;
+  int i;
+
+  for (i = n * SLICE; i < (n + 1) * SLICE; i++)
+    sums[n] += i;
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int total = 0;
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (sum_slice, (void *) i)) != TID_ERROR,
+           "create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "join thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    total += sums[i];
+  msg ("sum: %d", total);
+  CHECK (thread_join (tids[0]) == -1, "join thread 0 again");
+}
@@ -0,0 +1,51 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdint.h>
+
+/* Reads and returns the time-stamp counter, which counts CPU
+   cycles since reset. */
+static inline uint64_t
+rdtsc (void)
+{
+  /* See [IA32-v2b] "RDTSC". */
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Atomically stores NEW in *P and returns the old value of *P.
+   XCHG with a memory operand is always locked, and it also
+   serves as a full memory barrier. */
+static inline int
+atomic_xchg (volatile int *p, int new)
+{
+  /* See [IA32-v2b] "XCHG". */
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Atomically compares *P with OLD and, if they are equal,
+   stores NEW in *P.  Returns the old value of *P, so the store
+   took place if and only if the return value equals OLD. */
+static inline int
+atomic_cmpxchg (volatile int *p, int old, int new)
+{
+  /* See [IA32-v2a] "CMPXCHG". */
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p) : "r" (new), "0" (old) : "memory");
+  return prev;
+}
+
+/* Tells the CPU that it is in a spin-wait loop, which saves
+   power and, on a CPU with hyperthreads, frees resources for
+   its sibling. */
+static inline void
+cpu_relax (void)
+{
+  /* See [IA32-v2b] "PAUSE". */
+  asm volatile ("pause" : : : "memory");
+}
+
+#endif /* threads/cpu.h */
@@ -21,10 +21,14 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
@@ -98,6 +102,10 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  vmalloc_init ();
+
+  /* Find the other CPUs. */
+  smp_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -113,12 +121,18 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  futex_init ();
+  process_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  workqueue_init ();
+
+  /* Start the other CPUs. */
+  smp_start ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -254,8 +268,13 @@ parse_options (char **argv)
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
+      else if (!strcmp (name, "-sched"))
+        {
+          if (!thread_set_sched (value))
+            PANIC ("unknown scheduler `%s' (use -h for help)", value);
+        }
       else if (!strcmp (name, "-mlfqs"))
-        thread_mlfqs = true;
+        thread_set_sched ("mlfqs");
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -378,7 +397,9 @@ usage (void)
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
-          "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -sched=NAME        Use scheduler NAME: rr, priority (default),\n"
+          "                     mlfqs, or stride.\n"
+          "  -mlfqs             Same as -sched=mlfqs.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -6,8 +6,13 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 #include "devices/timer.h"
 
 /* Programmable Interrupt Controller (PIC) registers.
@@ -43,13 +48,32 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.
+
+   The local APICs' interrupts, at vectors INTR_LAPIC_FIRST and
+   up, are external interrupts too.  Each CPU keeps track of
+   whether it is processing one, and whether to yield on return,
+   in its struct cpu: before it yields, a CPU lets the others take
+   the kernel lock (see smp.c) and run interrupt handlers of their
+   own. */
+
+/* Softirqs run after an external interrupt handler returns and
+   the interrupt has been acknowledged, with interrupts turned
+   back on, so that long-running deferred work does not hold off
+   other interrupts.  They run in interrupt context all the same:
+   they may not sleep, and a thread they wake up preempts the
+   running thread only once they are done.  Another external
+   interrupt may arrive in the meantime, but softirqs never nest:
+   any it raises run in a later pass.  See run_softirqs().
+   Whether a CPU is running softirqs is in its struct cpu. */
+#define SOFTIRQ_PASSES 8        /* Max passes per interrupt. */
+static intr_softirq_func *softirq_handlers[SOFTIRQ_CNT];
+static unsigned softirq_pending;        /* Bit N set: softirq N raised. */
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
+static uint16_t pic_read_irr (void);
 
 /* Interrupt Descriptor Table helpers. */
 static uint64_t make_intr_gate (void (*) (void), int dpl);
@@ -58,6 +82,7 @@ static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
 
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
+static void run_softirqs (void);
 static void unexpected_interrupt (const struct intr_frame *);
 
 /* Returns the current interrupt status. */
@@ -88,7 +113,7 @@ enum intr_level
 intr_enable (void) 
 {
   enum intr_level old_level = intr_get_level ();
-  ASSERT (!intr_context ());
+  ASSERT (!cpu_current ()->in_external_intr);
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -181,7 +206,7 @@ void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name) 
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT ((vec_no >= 0x20 && vec_no <= 0x2f) || vec_no >= INTR_LAPIC_FIRST);
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -202,16 +227,18 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
-  ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT ((vec_no < 0x20 || vec_no > 0x2f) && vec_no < INTR_LAPIC_FIRST);
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt or
+   of softirqs and false at all other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  struct cpu *cpu = cpu_current ();
+
+  return cpu->in_external_intr || cpu->in_softirq;
 }
 
 /* During processing of an external interrupt, directs the
@@ -222,7 +249,40 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
+}
+
+/* Registers HANDLER to be called for softirq NR. */
+void
+intr_register_softirq (enum intr_softirq nr, intr_softirq_func *handler) 
+{
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (softirq_handlers[nr] == NULL);
+  softirq_handlers[nr] = handler;
+}
+
+/* Marks softirq NR pending.  It will run at the end of the
+   current external interrupt, if any, or otherwise of the next
+   one. */
+void
+intr_raise_softirq (enum intr_softirq nr) 
+{
+  enum intr_level old_level;
+
+  ASSERT (nr < SOFTIRQ_CNT);
+
+  old_level = intr_disable ();
+  softirq_pending |= 1u << nr;
+  intr_set_level (old_level);
+}
+
+/* Returns true if external interrupt VEC_NO has been raised but
+   not yet delivered, typically because interrupts are off. */
+bool
+intr_is_pending (uint8_t vec_no) 
+{
+  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  return (pic_read_irr () >> (vec_no - 0x20)) & 1;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -274,6 +334,17 @@ pic_end_of_interrupt (int irq)
     outb (0xa0, 0x20);
 }
 
+/* Returns the Interrupt Request Registers of both PICs, slave in
+   the high byte, which have a bit set for each IRQ that has been
+   raised but not yet delivered. */
+static uint16_t
+pic_read_irr (void) 
+{
+  outb (PIC0_CTRL, 0x0a); /* OCW3: next read returns the IRR. */
+  outb (PIC1_CTRL, 0x0a);
+  return inb (PIC0_CTRL) | (inb (PIC1_CTRL) << 8);
+}
+
 /* Creates an gate that invokes FUNCTION.
 
    The gate has descriptor privilege level DPL, meaning that it
@@ -346,26 +417,40 @@ intr_handler (struct intr_frame *frame)
 {
   bool external;
   intr_handler_func *handler;
+  enum intr_level old_level;
+  struct cpu *cpu;
+
+  /* Enter the kernel.  The CPU already holds the kernel lock
+     unless the interrupt came from user mode or from an idle
+     CPU. */
+  old_level = intr_disable ();
+  if (!kernel_lock_held ())
+    kernel_lock_acquire ();
+  intr_set_level (old_level);
+  cpu = cpu_current ();
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or local APIC
+     (see below).  An external interrupt handler cannot sleep. */
+  external = ((frame->vec_no >= 0x20 && frame->vec_no < 0x30)
+              || frame->vec_no >= INTR_LAPIC_FIRST);
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
+      ASSERT (!cpu->in_external_intr);
 
-      in_external_intr = true;
-      yield_on_return = false;
+      cpu->in_external_intr = true;
+      if (!cpu->in_softirq)
+        cpu->yield_on_return = false;
     }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == INTR_LAPIC_SPURIOUS)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -380,12 +465,66 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      cpu->in_external_intr = false;
+      if (frame->vec_no < INTR_LAPIC_FIRST)
+        pic_end_of_interrupt (frame->vec_no); 
+      else if (frame->vec_no != INTR_LAPIC_SPURIOUS)
+        lapic_eoi ();
+
+      /* If this interrupt arrived while softirqs were running,
+         return to them.  They yield for us if need be. */
+      if (cpu->in_softirq)
+        return;
+      if (softirq_pending != 0)
+        run_softirqs ();
 
-      if (yield_on_return) 
+      /* Give the CPUs waiting for the kernel lock their turn. */
+      kernel_lock_relax ();
+
+      if (cpu->yield_on_return) 
         thread_yield (); 
     }
+
+#ifdef USERPROG
+  /* A thread of an exiting process dies instead of returning to
+     user mode.  Otherwise, leave the kernel. */
+  if (frame->cs == SEL_UCSEG) 
+    {
+      if (process_exiting ())
+        thread_exit ();
+      intr_disable ();
+      kernel_lock_release ();
+    }
+#endif
+}
+
+/* Runs pending softirqs, with interrupts on while each handler
+   runs.  Softirqs raised meanwhile run in further passes, up to
+   SOFTIRQ_PASSES in all, after which the rest wait for the next
+   interrupt so that a flood of them cannot starve threads.
+   Interrupts must be off on entry and are off on return. */
+static void
+run_softirqs (void) 
+{
+  struct cpu *cpu = cpu_current ();
+  int pass;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cpu->in_softirq = true;
+  for (pass = 0; pass < SOFTIRQ_PASSES && softirq_pending != 0; pass++) 
+    {
+      unsigned pending = softirq_pending;
+      int nr;
+
+      softirq_pending = 0;
+      intr_enable ();
+      for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+        if ((pending & (1u << nr)) && softirq_handlers[nr] != NULL)
+          softirq_handlers[nr] ();
+      intr_disable ();
+    }
+  cpu->in_softirq = false;
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -57,12 +57,25 @@ struct intr_frame
 
 typedef void intr_handler_func (struct intr_frame *);
 
+/* Softirqs: work deferred from an external interrupt handler
+   until after the interrupt has been acknowledged. */
+enum intr_softirq
+  {
+    SOFTIRQ_TIMER,        /* Timer callbacks (devices/timer.c). */
+    SOFTIRQ_CNT           /* Number of softirqs. */
+  };
+
+typedef void intr_softirq_func (void);
+
 void intr_init (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
+void intr_register_softirq (enum intr_softirq, intr_softirq_func *);
+void intr_raise_softirq (enum intr_softirq);
+bool intr_is_pending (uint8_t vec);
 
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
@@ -7,7 +7,9 @@
 #include <string.h>
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -26,13 +28,29 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   and give the arena back to the page allocator.  Each
+   descriptor keeps one such empty arena back, though, so that a
+   block allocated and freed over and over does not take and
+   return a page each time.
+
+   In front of the smallest descriptors, each thread has a
+   "magazine" of a few free blocks per descriptor, after Bonwick
+   and Adams, "Magazines and Vmem" (USENIX 2001).  malloc() and
+   free() take blocks from and put them in the current thread's
+   magazine without locking.  Only when the magazine is empty, or
+   full, do they lock the descriptor, and then they move half a
+   magazine's worth of blocks at once.  Blocks in a magazine
+   count as in use as far as their arena is concerned.  A thread
+   gives back its magazines' blocks when it exits.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If the
+   page allocator has no run of free pages that long, we get the
+   pages from vmalloc() instead, which needs them only to be
+   virtually contiguous. */
 
 /* Descriptor. */
 struct desc
@@ -41,6 +59,7 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    int empty_cnt;              /* Arenas with no blocks in use. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,8 +83,15 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Blocks moved between a magazine and its descriptor at once. */
+#define MAG_BATCH (MAG_SIZE / 2)
+
+bool malloc_magazines = true;
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *desc_get (struct desc *);
+static void desc_put (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,8 +106,28 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
-      lock_init (&d->lock);
+      lock_init (&d->lock, "malloc desc");
+      d->empty_cnt = 0;
     }
+  ASSERT (desc_cnt >= MAG_CLASS_CNT);
+}
+
+/* Gives the blocks in the current thread's magazines back to
+   their descriptors.  Called by thread_exit(). */
+void
+malloc_thread_exit (void) 
+{
+  struct magazines *m = &thread_current ()->mags;
+  size_t c;
+
+  for (c = 0; c < MAG_CLASS_CNT; c++)
+    if (m->cnt[c] > 0)
+      {
+        lock_acquire (&descs[c].lock);
+        while (m->cnt[c] > 0)
+          desc_put (&descs[c], m->blocks[c][--m->cnt[c]]);
+        lock_release (&descs[c].lock);
+      }
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -108,6 +154,8 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL && page_cnt > 1)
+        a = vmalloc (page_cnt * PGSIZE);
       if (a == NULL)
         return NULL;
 
@@ -119,36 +167,27 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Take a block from the current thread's magazine, first
+     filling it halfway if it is empty. */
+  if (d < descs + MAG_CLASS_CNT && malloc_magazines) 
     {
-      size_t i;
+      struct magazines *m = &thread_current ()->mags;
+      size_t c = d - descs;
 
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
+      if (m->cnt[c] == 0) 
         {
+          lock_acquire (&d->lock);
+          while (m->cnt[c] < MAG_BATCH && (b = desc_get (d)) != NULL)
+            m->blocks[c][m->cnt[c]++] = b;
           lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
+          if (m->cnt[c] == 0)
+            return NULL;
         }
+      return m->blocks[c][--m->cnt[c]];
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  lock_acquire (&d->lock);
+  b = desc_get (d);
   lock_release (&d->lock);
   return b;
 }
@@ -232,32 +271,36 @@ free (void *p)
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Put the block in the current thread's magazine,
+             first emptying it halfway if it is full. */
+          if (d < descs + MAG_CLASS_CNT && malloc_magazines) 
             {
-              size_t i;
+              struct magazines *m = &thread_current ()->mags;
+              size_t c = d - descs;
 
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              if (m->cnt[c] == MAG_SIZE) 
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  lock_acquire (&d->lock);
+                  while (m->cnt[c] > MAG_SIZE - MAG_BATCH)
+                    desc_put (d, m->blocks[c][--m->cnt[c]]);
+                  lock_release (&d->lock);
                 }
-              palloc_free_page (a);
+              m->blocks[c][m->cnt[c]++] = b;
+              return;
             }
-
+  
+          lock_acquire (&d->lock);
+          desc_put (d, b);
           lock_release (&d->lock);
         }
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          if (is_vmalloc_vaddr (a))
+            vfree (a);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
@@ -292,3 +335,74 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+/* Takes a block from D's free list and returns it, first
+   creating a new arena if the list is empty.  Returns a null
+   pointer if memory is not available.  D's lock must be held. */
+static struct block *
+desc_get (struct desc *d) 
+{
+  struct block *b;
+  struct arena *a;
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = palloc_get_page (0);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      d->empty_cnt++;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_cnt--;
+  return b;
+}
+
+/* Adds block B to D's free list.  If that leaves B's arena with
+   no blocks in use, and D already has an arena like that, frees
+   B's arena.  D's lock must be held. */
+static void
+desc_put (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, keep it if it is the
+     only such arena, otherwise free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      if (d->empty_cnt == 0) 
+        {
+          d->empty_cnt++;
+          return;
+        }
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+    }
+}
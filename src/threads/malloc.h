@@ -2,9 +2,30 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/* Number of size classes, smallest first, that have per-thread
+   magazines, and the number of blocks a magazine holds. */
+#define MAG_CLASS_CNT 5
+#define MAG_SIZE 6
+
+/* A thread's magazines: for each of the smallest size classes,
+   a few free blocks that malloc() and free() can use without
+   locking.  Owned by threads/malloc.c. */
+struct magazines
+  {
+    uint8_t cnt[MAG_CLASS_CNT];                 /* Blocks held. */
+    void *blocks[MAG_CLASS_CNT][MAG_SIZE];      /* Stacks of blocks. */
+  };
+
+/* If false, malloc() and free() bypass the magazines.  For
+   benchmarking. */
+extern bool malloc_magazines;
 
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
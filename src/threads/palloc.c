@@ -2,12 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -23,14 +26,56 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  Free memory is kept as blocks of 1 << ORDER pages,
+   each starting at a page index that is a multiple of its size,
+   on one free list per order.  An allocation of PAGE_CNT pages
+   takes the smallest free block that is big enough, splits it in
+   half until it is no bigger than needed, and gives the pages
+   past PAGE_CNT back.  Freeing a block merges it with its
+   "buddy", the other half of the block it was split from, for as
+   long as the buddy is free too.  Either way the cost depends on
+   the number of orders, not on how full the pool is.
+
+   Each pool also keeps a small stack of pages that the idle
+   thread has already filled with zeros, in palloc_zero_idle().
+   A PAL_ZERO request for a single page takes one of those if it
+   can, instead of zeroing a page while the caller waits.  Pages
+   on the stack are allocated as far as the buddy allocator is
+   concerned, so when an allocation would otherwise fail, the
+   stack is given back first. */
+
+/* Most pre-zeroed pages kept per pool. */
+#define ZEROED_MAX 32
+
+/* Number of block orders.  The largest block, 1 << (ORDER_CNT -
+   1) pages, is bigger than any pool. */
+#define ORDER_CNT 20
+
+/* Header at the start of each free block. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in a free list. */
+    unsigned order;                     /* Block has 1 << ORDER pages. */
+  };
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct bitmap *used_map;            /* Bitmap of used pages. */
     uint8_t *base;                      /* Base of pool. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks, by order. */
+
+    struct spinlock zeroed_lock;        /* Protects members below. */
+    void *zeroed[ZEROED_MAX];           /* Pre-zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pre-zeroed pages. */
+    size_t zeroing_cnt;                 /* Slots reserved by zero_page(). */
+    long long zero_hits;                /* PAL_ZERO pages pre-zeroed. */
+    long long zero_misses;              /* PAL_ZERO pages zeroed late. */
+    const char *name;                   /* Name, for statistics. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +84,11 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static bool drain_zeroed (struct pool *);
+static bool zero_page (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -77,10 +127,25 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (page_cnt == 0)
     return NULL;
 
+  if ((flags & PAL_ZERO) && page_cnt == 1) 
+    {
+      pages = take_zeroed (pool);
+      if (pages != NULL)
+        return pages;
+    }
+
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  page_idx = alloc_pages (pool, page_cnt);
   lock_release (&pool->lock);
 
+  /* Give back the pre-zeroed pages and try again. */
+  if (page_idx == BITMAP_ERROR && drain_zeroed (pool)) 
+    {
+      lock_acquire (&pool->lock);
+      page_idx = alloc_pages (pool, page_cnt);
+      lock_release (&pool->lock);
+    }
+
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
   else
@@ -137,8 +202,10 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  lock_acquire (&pool->lock);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  free_pages (pool, page_idx, page_cnt);
+  lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -148,6 +215,30 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Zeroes a free page for a later PAL_ZERO request, if any pool
+   is short of pre-zeroed pages.  Returns true if it zeroed a
+   page, false if there was nothing to do or the pool was busy.
+   Called by the idle thread, with interrupts on, so that zeroing
+   a page does not delay a thread that becomes ready. */
+bool
+palloc_zero_idle (void) 
+{
+  return zero_page (&user_pool) || zero_page (&kernel_pool);
+}
+
+/* Prints statistics about pre-zeroed pages. */
+void
+palloc_print_stats (void) 
+{
+  struct pool *pools[] = { &kernel_pool, &user_pool };
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    printf ("Pre-zeroed pages in %s: %lld hits, %lld misses, %zu ready\n",
+            pools[i]->name, pools[i]->zero_hits, pools[i]->zero_misses,
+            pools[i]->zeroed_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -157,6 +248,7 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
   size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  unsigned i;
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +256,19 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
+  lock_init (&p->lock, name);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
+  for (i = 0; i < ORDER_CNT; i++)
+    list_init (&p->free_lists[i]);
+  bitmap_set_all (p->used_map, true);
+  free_pages (p, 0, page_cnt);
+
+  spinlock_init (&p->zeroed_lock);
+  p->zeroed_cnt = 0;
+  p->zeroing_cnt = 0;
+  p->zero_hits = p->zero_misses = 0;
+  p->name = name;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +282,218 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the free block header for the block at PAGE_IDX in
+   POOL. */
+static struct free_block *
+block_at (const struct pool *pool, size_t page_idx) 
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index of the page that BLOCK starts at in POOL. */
+static size_t
+block_idx (const struct pool *pool, const struct free_block *block) 
+{
+  return ((uint8_t *) block - pool->base) / PGSIZE;
+}
+
+/* Puts the block of 1 << ORDER pages at PAGE_IDX in POOL on the
+   free list for ORDER. */
+static void
+push_block (struct pool *pool, size_t page_idx, unsigned order) 
+{
+  struct free_block *b = block_at (pool, page_idx);
+  b->order = order;
+  list_push_front (&pool->free_lists[order], &b->elem);
+}
+
+/* Takes PAGE_CNT pages out of POOL's free lists and marks them
+   used.  Returns the index of the first page, or BITMAP_ERROR if
+   no free block is big enough.  POOL's lock must be held. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) 
+{
+  struct free_block *b;
+  unsigned order, want;
+  size_t page_idx;
+
+  /* Find the smallest order that holds PAGE_CNT pages, then the
+     smallest free block of at least that order. */
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want + 1 >= ORDER_CNT)
+      return BITMAP_ERROR;
+  for (order = want; list_empty (&pool->free_lists[order]); order++)
+    if (order + 1 >= ORDER_CNT)
+      return BITMAP_ERROR;
+
+  b = list_entry (list_pop_front (&pool->free_lists[order]),
+                  struct free_block, elem);
+  ASSERT (b->order == order);
+  page_idx = block_idx (pool, b);
+
+  /* Split off upper halves until the block is the right size. */
+  while (order > want) 
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+
+  /* Give back the pages past PAGE_CNT. */
+  ASSERT (bitmap_none (pool->used_map, page_idx, (size_t) 1 << want));
+  bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << want, true);
+  free_pages (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+  return page_idx;
+}
+
+/* Puts the block of 1 << ORDER pages at PAGE_IDX in POOL on a
+   free list, first merging it with its buddy as many times as
+   possible.  The block's pages must already be marked free.
+   POOL's lock must be held. */
+static void
+release_block (struct pool *pool, size_t page_idx, unsigned order) 
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  while (order + 1 < ORDER_CNT) 
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      struct free_block *buddy;
+
+      /* The buddy's first page, if free, must begin a free block,
+         because any free block that covered it and started
+         earlier would cover our block too.  That block may still
+         be smaller than ours. */
+      if (buddy_idx + ((size_t) 1 << order) > page_cnt
+          || bitmap_test (pool->used_map, buddy_idx))
+        break;
+      buddy = block_at (pool, buddy_idx);
+      if (buddy->order != order)
+        break;
+
+      list_remove (&buddy->elem);
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Marks the PAGE_CNT used pages starting at PAGE_IDX in POOL
+   free and returns them to its free lists, as the biggest aligned
+   blocks that fit.  Each block is marked free only as it is
+   released, so that an earlier block never mistakes a later one,
+   whose header is not yet written, for a free buddy.  POOL's lock
+   must be held. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0) 
+    {
+      unsigned order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order,
+                           false);
+      release_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Takes a pre-zeroed page from POOL and returns it, or returns a
+   null pointer if there are none.  Counts a hit or a miss. */
+static void *
+take_zeroed (struct pool *pool) 
+{
+  void *page = NULL;
+
+  spinlock_acquire (&pool->zeroed_lock);
+  if (pool->zeroed_cnt > 0) 
+    {
+      page = pool->zeroed[--pool->zeroed_cnt];
+      pool->zero_hits++;
+    }
+  else
+    pool->zero_misses++;
+  spinlock_release (&pool->zeroed_lock);
+
+  return page;
+}
+
+/* Returns all of POOL's pre-zeroed pages to its free lists.
+   Returns true if there were any. */
+static bool
+drain_zeroed (struct pool *pool) 
+{
+  bool drained = false;
+
+  lock_acquire (&pool->lock);
+  spinlock_acquire (&pool->zeroed_lock);
+  while (pool->zeroed_cnt > 0) 
+    {
+      uint8_t *page = pool->zeroed[--pool->zeroed_cnt];
+      free_pages (pool, (page - pool->base) / PGSIZE, 1);
+      drained = true;
+    }
+  spinlock_release (&pool->zeroed_lock);
+  lock_release (&pool->lock);
+
+  return drained;
+}
+
+/* Takes a free page from POOL, zeroes it, and adds it to POOL's
+   pre-zeroed pages, if POOL has room for more.  Returns true if
+   it zeroed a page.
+
+   The idle thread never waits for POOL's lock, and it holds the
+   lock with interrupts off, because while the idle thread is
+   preempted, it does not run again until nothing else is ready,
+   and a thread waiting for the lock would wait that long too.
+
+   Each CPU's idle thread may be zeroing a page for POOL at the
+   same time, so each one reserves a slot among the pre-zeroed
+   pages before it starts. */
+static bool
+zero_page (struct pool *pool) 
+{
+  enum intr_level old_level;
+  size_t page_idx;
+  void *page;
+  bool reserved;
+
+  spinlock_acquire (&pool->zeroed_lock);
+  reserved = pool->zeroed_cnt + pool->zeroing_cnt < ZEROED_MAX;
+  if (reserved)
+    pool->zeroing_cnt++;
+  spinlock_release (&pool->zeroed_lock);
+  if (!reserved)
+    return false;
+
+  old_level = intr_disable ();
+  page_idx = BITMAP_ERROR;
+  if (lock_try_acquire (&pool->lock)) 
+    {
+      page_idx = alloc_pages (pool, 1);
+      lock_release (&pool->lock);
+    }
+  intr_set_level (old_level);
+
+  page = NULL;
+  if (page_idx != BITMAP_ERROR) 
+    {
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+    }
+
+  spinlock_acquire (&pool->zeroed_lock);
+  pool->zeroing_cnt--;
+  if (page != NULL)
+    pool->zeroed[pool->zeroed_cnt++] = page;
+  spinlock_release (&pool->zeroed_lock);
+  return page != NULL;
+}
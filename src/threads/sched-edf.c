@@ -0,0 +1,231 @@
+#include "threads/sched.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Earliest-deadline-first real-time scheduling, with bandwidth
+   reservations in the style of the Constant Bandwidth Server
+   (Abeni and Buttazzo, 1998).
+
+   An EDF thread reserves RUNTIME ticks of CPU time in every
+   PERIOD ticks.  Admission control refuses a reservation that
+   would raise the total reserved utilization above
+   EDF_UTIL_MAX, so that the admitted threads can always meet
+   their deadlines and some time is left for other classes.
+
+   Each EDF thread has an absolute deadline and a budget of ticks
+   left before that deadline.  The ready thread with the earliest
+   deadline runs first, ahead of every thread in the other
+   classes.  Each tick that the thread runs takes one tick from
+   its budget.  A thread that uses up its budget is throttled: it
+   drops to the normal class until its deadline, when a timer
+   gives it a new budget and a deadline one period later and
+   moves it back.  Throttling keeps a thread that overruns its
+   reservation from hurting the others.
+
+   A thread that wakes up keeps its deadline and budget, unless
+   running out the budget before the deadline would use more
+   than its reserved share.  In that case it starts a fresh
+   period at once.
+
+   Each CPU has an EDF run queue of its own, but admission
+   control still counts the utilization of all EDF threads
+   against a single CPU, because nothing keeps two of them from
+   landing on the same CPU. */
+
+/* Reserved utilization, in thousandths of the CPU. */
+#define EDF_UTIL_SCALE 1000
+#define EDF_UTIL_MAX 900
+
+/* Ready EDF threads on each CPU, in increasing order of
+   deadline.  Threads with equal deadlines are kept in FIFO
+   order. */
+static struct list edf_queue[CPU_MAX];
+
+/* Total utilization reserved by admitted threads. */
+static int edf_util;
+
+static void edf_replenish (void *t_);
+
+/* Returns the utilization of a reservation of RUNTIME ticks
+   every PERIOD ticks, rounded up. */
+static int
+util_of (int runtime, int period)
+{
+  return DIV_ROUND_UP ((int64_t) runtime * EDF_UTIL_SCALE, period);
+}
+
+/* Reserves RUNTIME ticks of every PERIOD ticks for a thread
+   about to become an EDF thread.  Returns true if successful,
+   false if the reservation does not fit.  Interrupts must be
+   off. */
+bool
+sched_edf_reserve (int runtime, int period)
+{
+  int util = util_of (runtime, period);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (0 < runtime && runtime <= period);
+
+  if (edf_util + util > EDF_UTIL_MAX)
+    return false;
+  edf_util += util;
+  return true;
+}
+
+/* Gives T, for which sched_edf_reserve() has already reserved
+   RUNTIME ticks of every PERIOD ticks, its EDF parameters and a
+   first period starting now.  The caller must also move T to
+   the EDF class.  Interrupts must be off. */
+void
+sched_edf_attach (struct thread *t, int runtime, int period)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->edf_period == 0);
+
+  t->edf_runtime = runtime;
+  t->edf_period = period;
+  t->edf_deadline = timer_ticks () + period;
+  t->edf_budget = runtime;
+  timer_setup (&t->edf_timer, edf_replenish, t);
+}
+
+/* Releases EDF thread T's reservation and cancels any pending
+   replenishment.  The caller must also move T to a class other
+   than EDF.  Interrupts must be off. */
+void
+sched_edf_detach (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->edf_period != 0);
+
+  timer_cancel (&t->edf_timer);
+  edf_util -= util_of (t->edf_runtime, t->edf_period);
+  t->edf_runtime = t->edf_period = 0;
+}
+
+/* Timer callback that ends throttled thread T_'s period: it
+   gets a fresh budget and moves back to the EDF class. */
+static void
+edf_replenish (void *t_)
+{
+  struct thread *t = t_;
+  enum intr_level old_level;
+  int64_t now;
+
+  old_level = intr_disable ();
+  now = timer_ticks ();
+  t->edf_deadline += t->edf_period;
+  if (t->edf_deadline <= now)
+    t->edf_deadline = now + t->edf_period;
+  t->edf_budget = t->edf_runtime;
+  thread_change_policy (t, SCHED_EDF);
+  intr_set_level (old_level);
+
+  thread_check_preempt ();
+}
+
+/* Returns true if thread A's deadline is earlier than thread
+   B's. */
+static bool
+deadline_less (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->edf_deadline < b->edf_deadline;
+}
+
+static void
+edf_init (void)
+{
+  int i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    list_init (&edf_queue[i]);
+}
+
+/* Adds T to the run queue.  If T has more budget left than its
+   share of the time until its deadline, then T starts a new
+   period, so that it cannot run more than its share. */
+static void
+edf_enqueue (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->edf_budget > 0);
+
+  if (t->edf_deadline <= now
+      || ((int64_t) t->edf_budget * t->edf_period
+          > (t->edf_deadline - now) * t->edf_runtime))
+    {
+      t->edf_deadline = now + t->edf_period;
+      t->edf_budget = t->edf_runtime;
+    }
+  list_insert_ordered (&edf_queue[t->cpu->id], &t->elem, deadline_less, NULL);
+}
+
+static void
+edf_dequeue (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+}
+
+static struct thread *
+edf_pick_next (struct cpu *cpu)
+{
+  struct list *queue = &edf_queue[cpu->id];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (queue))
+    return NULL;
+  return list_entry (list_pop_front (queue), struct thread, elem);
+}
+
+/* Returns true if an EDF thread ready on CUR's CPU has an
+   earlier deadline than CUR. */
+static bool
+edf_preempt (const struct thread *cur)
+{
+  struct list *queue = &edf_queue[cur->cpu->id];
+  const struct thread *first;
+
+  if (list_empty (queue))
+    return false;
+  first = list_entry (list_front (queue), struct thread, elem);
+  return first->edf_deadline < cur->edf_deadline;
+}
+
+/* Charges one tick to CUR's budget, and throttles CUR if that
+   uses the budget up. */
+static void
+edf_tick (struct thread *cur)
+{
+  if (--cur->edf_budget > 0)
+    return;
+
+  thread_change_policy (cur, SCHED_NORMAL);
+  timer_add (&cur->edf_timer, cur->edf_deadline);
+  intr_yield_on_return ();
+}
+
+const struct sched_class sched_edf =
+  {
+    "edf",
+    edf_init,
+    edf_enqueue,
+    edf_dequeue,
+    edf_pick_next,
+    edf_preempt,
+    edf_tick,
+    NULL,
+    NULL
+  };
@@ -0,0 +1,132 @@
+#include "threads/sched.h"
+#include <debug.h>
+#include <list.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Stride scheduling, a deterministic proportional-share policy
+   described by Waldspurger and Weihl in "Stride Scheduling:
+   Deterministic Proportional-Share Resource Management" (1995).
+
+   Each thread holds some number of tickets.  For every timer
+   tick that a thread runs, its virtual time, or "pass", advances
+   by its stride, which is STRIDE1 divided by its tickets.  The
+   ready thread with the smallest pass runs next.  Thus, over any
+   interval, CPU-bound threads receive ticks in proportion to
+   their tickets, give or take a time slice, without the
+   randomness of lottery scheduling.
+
+   A thread keeps its pass while it is blocked, but a thread that
+   becomes ready never starts out behind global_pass, the pass of
+   the thread its CPU most recently chose to run.  Otherwise, a
+   thread that slept for a long time could monopolize the CPU
+   until it caught up.
+
+   Each CPU has a run queue and a global_pass of its own, so
+   shares are proportional among the threads that share a CPU.
+   The run queue is kept sorted, so adding a thread to it takes
+   time linear in the number of ready threads. */
+
+/* Pass by which one tick advances a thread with one ticket. */
+#define STRIDE1 (1 << 20)
+
+/* Ready threads on each CPU, in increasing order of pass.
+   Threads with equal passes are kept in FIFO order. */
+static struct list run_queue[CPU_MAX];
+
+/* Pass of the thread each CPU most recently chose to run. */
+static int64_t global_pass[CPU_MAX];
+
+/* Returns true if thread A's pass is less than thread B's. */
+static bool
+pass_less (const struct list_elem *a_, const struct list_elem *b_,
+           void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->pass < b->pass;
+}
+
+static void
+stride_init (void)
+{
+  int i;
+
+  for (i = 0; i < CPU_MAX; i++) 
+    {
+      list_init (&run_queue[i]);
+      global_pass[i] = 0;
+    }
+}
+
+static void
+stride_enqueue (struct thread *t)
+{
+  unsigned id = t->cpu->id;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->pass < global_pass[id])
+    t->pass = global_pass[id];
+  list_insert_ordered (&run_queue[id], &t->elem, pass_less, NULL);
+}
+
+static void
+stride_dequeue (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+}
+
+static struct thread *
+stride_pick_next (struct cpu *cpu)
+{
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (&run_queue[cpu->id]))
+    return NULL;
+  t = list_entry (list_pop_front (&run_queue[cpu->id]), struct thread, elem);
+  global_pass[cpu->id] = t->pass;
+  return t;
+}
+
+/* A thread that becomes ready waits for the running thread's
+   time slice to end, so that shares stay proportional to
+   tickets no matter how often threads block. */
+static bool
+stride_preempt (const struct thread *cur UNUSED)
+{
+  return false;
+}
+
+/* Charges one tick to CUR. */
+static void
+stride_tick (struct thread *cur)
+{
+  cur->pass += STRIDE1 / cur->tickets;
+}
+
+/* A new thread inherits its parent's tickets.  Its pass is set
+   when it first enters the run queue. */
+static void
+stride_fork (struct thread *t, const struct thread *parent)
+{
+  t->tickets = parent->tickets;
+}
+
+const struct sched_class sched_stride =
+  {
+    "stride",
+    stride_init,
+    stride_enqueue,
+    stride_dequeue,
+    stride_pick_next,
+    stride_preempt,
+    stride_tick,
+    stride_fork,
+    NULL
+  };
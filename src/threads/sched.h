@@ -0,0 +1,77 @@
+#ifndef THREADS_SCHED_H
+#define THREADS_SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/smp.h"
+#include "threads/thread.h"
+
+/* A scheduling class, the policy that decides which ready
+   thread runs next among the threads of one scheduling policy.
+   Threads with policy SCHED_NORMAL use the class chosen at boot
+   with the "-sched" option, SCHED_EDF threads use sched_edf, and
+   SCHED_IDLE threads use sched_idle.
+
+   thread.c keeps the run queue's bookkeeping that does not
+   depend on the policy, such as the count of ready threads, and
+   calls into the class to do the rest.  Every function is called
+   with interrupts off.  The idle thread is never put in the run
+   queue.
+
+   Each class keeps a run queue for each CPU.  A ready thread T
+   is on the run queue of T->cpu, which thread.c sets before
+   enqueue() and leaves alone until dequeue() or pick_next(). */
+struct sched_class
+  {
+    const char *name;                   /* Name for "-sched" option. */
+
+    /* Initializes the run queues of all CPUs. */
+    void (*init) (void);
+
+    /* Adds T, which is becoming ready, to T->cpu's run queue. */
+    void (*enqueue) (struct thread *t);
+
+    /* Removes ready thread T from T->cpu's run queue. */
+    void (*dequeue) (struct thread *t);
+
+    /* Removes and returns the thread to run next from CPU's run
+       queue, or returns a null pointer if it is empty. */
+    struct thread *(*pick_next) (struct cpu *cpu);
+
+    /* Returns true if CUR, running on CUR->cpu, should give up
+       the CPU right away to a thread in that CPU's run queue. */
+    bool (*preempt) (const struct thread *cur);
+
+    /* Optional.  Does per-tick bookkeeping for running thread
+       CUR.  Runs in an external interrupt context.  The normal
+       class's function is called on every tick, whatever CUR's
+       policy, and others only while CUR has their policy. */
+    void (*tick) (struct thread *cur);
+
+    /* Optional.  Sets up scheduling state for new thread T
+       created by PARENT. */
+    void (*fork) (struct thread *t, const struct thread *parent);
+
+    /* Optional.  Implements thread_tick_deadline() for the
+       normal class.  If null, the class has no work to do on
+       ticks while idle. */
+    int64_t (*tick_deadline) (int64_t now);
+  };
+
+/* Scheduling classes. */
+extern const struct sched_class sched_rr;         /* thread.c. */
+extern const struct sched_class sched_priority;   /* thread.c. */
+extern const struct sched_class sched_mlfqs;      /* thread.c. */
+extern const struct sched_class sched_stride;     /* sched-stride.c. */
+extern const struct sched_class sched_edf;        /* sched-edf.c. */
+extern const struct sched_class sched_idle;       /* thread.c. */
+
+/* For scheduling classes, in thread.c. */
+void thread_change_policy (struct thread *, enum sched_policy);
+
+/* EDF reservations, in sched-edf.c. */
+bool sched_edf_reserve (int runtime, int period);
+void sched_edf_attach (struct thread *, int runtime, int period);
+void sched_edf_detach (struct thread *);
+
+#endif /* threads/sched.h */
@@ -0,0 +1,272 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator" (USENIX 1994).
+
+   malloc() rounds every request up to a power of 2, so an object
+   just over a power of 2 wastes nearly half of its block.  A
+   slab cache instead holds objects of one exact size.  It gets
+   memory from the page allocator one page, or "slab", at a time.
+   Each slab begins with a header, followed by as many objects as
+   fit.
+
+   The header holds the slab's free list as an array of object
+   indexes, one per object, rather than threading it through the
+   free objects.  That way freeing an object never overwrites
+   it, so a cache may have a constructor: it initializes each
+   object once, when its slab is created, and callers hand
+   objects back in their constructed state.
+
+   The space left over at the end of a slab is used for "cache
+   coloring": each new slab starts its objects one cache line
+   further in than the one before, wrapping around when the
+   leftover space runs out, so that objects at the same index in
+   different slabs do not all compete for the same cache lines.
+
+   A cache keeps its slabs with free objects on a list and
+   allocates from the first of them.  When a slab becomes empty,
+   the cache keeps it back as a spare if it has none, and
+   otherwise returns the page to the page allocator.  This stops
+   an object being allocated and freed over and over on the edge
+   of a slab from allocating and freeing a page each time. */
+
+/* Alignment of color offsets.  A typical cache line size. */
+#define COLOR_ALIGN 64
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Marks the end of a slab's free list. */
+#define FREE_END UINT16_MAX
+
+/* Header at the start of each slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial list. */
+    uint8_t *objs;              /* First object. */
+    size_t in_use;              /* Number of allocated objects. */
+    uint16_t free_idx;          /* First free object, or FREE_END. */
+    uint16_t next_free[];       /* Free list links, by object. */
+  };
+
+/* All caches, for slab_print_stats(). */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static size_t header_size (size_t obj_cnt);
+static struct slab *new_slab (struct slab_cache *);
+static struct slab *obj_to_slab (struct slab_cache *, void *obj);
+
+/* Initializes C as a cache of OBJ_SIZE-byte objects, named NAME
+   for statistics.  If CTOR is nonnull, it is called on each
+   object when the object's slab is created; callers must return
+   objects to slab_free() in the state CTOR left them in.  CTOR
+   is called with C's lock held, so it must not allocate from C.
+
+   OBJ_SIZE must be small enough for several objects to fit in
+   a page.  Use malloc() for bigger objects. */
+void
+slab_cache_init (struct slab_cache *c, const char *name, size_t obj_size,
+                 slab_ctor *ctor)
+{
+  size_t leftover;
+
+  ASSERT (c != NULL);
+  ASSERT (obj_size > 0);
+
+  c->name = name;
+  c->obj_size = ROUND_UP (obj_size, sizeof (uint32_t));
+  c->obj_cnt = (PGSIZE - header_size (0)) / (c->obj_size + sizeof (uint16_t));
+  while (c->obj_cnt > 0
+         && header_size (c->obj_cnt) + c->obj_cnt * c->obj_size > PGSIZE)
+    c->obj_cnt--;
+  ASSERT (c->obj_cnt >= 2 && c->obj_cnt < FREE_END);
+  c->ctor = ctor;
+  leftover = PGSIZE - header_size (c->obj_cnt) - c->obj_cnt * c->obj_size;
+  c->color_max = leftover / COLOR_ALIGN * COLOR_ALIGN;
+  c->color_next = 0;
+
+  lock_init (&c->lock, name);
+  list_init (&c->partial);
+  c->spare = NULL;
+
+  c->alloc_cnt = c->free_cnt = 0;
+  c->slab_cnt = c->max_slab_cnt = 0;
+  c->in_use = c->max_in_use = 0;
+
+  list_push_back (&all_caches, &c->elem);
+}
+
+/* Allocates and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c) 
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->partial)) 
+    {
+      if (c->spare != NULL)
+        {
+          s = c->spare;
+          c->spare = NULL;
+        }
+      else
+        {
+          s = new_slab (c);
+          if (s == NULL) 
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take the first free object of the first partial slab. */
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  ASSERT (s->free_idx != FREE_END);
+  obj = s->objs + s->free_idx * c->obj_size;
+  s->free_idx = s->next_free[s->free_idx];
+  if (++s->in_use == c->obj_cnt)
+    list_remove (&s->elem);
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->max_in_use)
+    c->max_in_use = c->in_use;
+  lock_release (&c->lock);
+
+  return obj;
+}
+
+/* Frees OBJ, which must have been allocated from cache C. */
+void
+slab_free (struct slab_cache *c, void *obj) 
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - s->objs) / c->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     that would undo its constructor. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->in_use > 0);
+  s->next_free[idx] = s->free_idx;
+  s->free_idx = idx;
+  if (s->in_use-- == c->obj_cnt)
+    list_push_front (&c->partial, &s->elem);
+  if (s->in_use == 0) 
+    {
+      list_remove (&s->elem);
+      if (c->spare == NULL)
+        c->spare = s;
+      else 
+        {
+          s->magic = 0;
+          palloc_free_page (s);
+          c->slab_cnt--;
+        }
+    }
+  c->free_cnt++;
+  c->in_use--;
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each cache. */
+void
+slab_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+
+      printf ("Slab cache %s: %zu-byte objects, %zu per slab; "
+              "%d in use, max %d; %d slabs, max %d\n",
+              c->name, c->obj_size, c->obj_cnt, c->in_use, c->max_in_use,
+              c->slab_cnt, c->max_slab_cnt);
+      printf ("Slab cache %s: %lld allocations, %lld frees\n",
+              c->name, c->alloc_cnt, c->free_cnt);
+    }
+}
+
+/* Returns the number of bytes in the header of a slab with
+   OBJ_CNT objects. */
+static size_t
+header_size (size_t obj_cnt) 
+{
+  return ROUND_UP (sizeof (struct slab) + obj_cnt * sizeof (uint16_t),
+                   sizeof (uint32_t));
+}
+
+/* Allocates a new slab for cache C, constructs its objects, and
+   returns it.  Returns a null pointer if memory is not
+   available.  C's lock must be held. */
+static struct slab *
+new_slab (struct slab_cache *c) 
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->objs = (uint8_t *) s + header_size (c->obj_cnt) + c->color_next;
+  s->in_use = 0;
+  s->free_idx = 0;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->next_free[i] = i + 1 < c->obj_cnt ? i + 1 : FREE_END;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->obj_size);
+    }
+
+  c->color_next += COLOR_ALIGN;
+  if (c->color_next > c->color_max)
+    c->color_next = 0;
+  if (++c->slab_cnt > c->max_slab_cnt)
+    c->max_slab_cnt = c->slab_cnt;
+  return s;
+}
+
+/* Returns the slab that OBJ, an object in cache C, is in. */
+static struct slab *
+obj_to_slab (struct slab_cache *c, void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that OBJ is an object in the slab. */
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % c->obj_size == 0);
+  ASSERT (((uint8_t *) obj - s->objs) / c->obj_size < c->obj_cnt);
+
+  return s;
+}
@@ -0,0 +1,43 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Object constructor.  Called once on each object when the page
+   holding it is added to a cache, not on every allocation. */
+typedef void slab_ctor (void *obj);
+
+/* A cache of objects of one type.  Initialize with
+   slab_cache_init().  See slab.c for details. */
+struct slab_cache
+  {
+    struct list_elem elem;      /* Element in list of all caches. */
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Bytes per object. */
+    size_t obj_cnt;             /* Objects per slab. */
+    slab_ctor *ctor;            /* Constructor, or null. */
+    size_t color_max;           /* Greatest color offset. */
+    size_t color_next;          /* Color offset for the next slab. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct list partial;        /* Slabs with free objects. */
+    struct slab *spare;         /* Empty slab kept back, or null. */
+
+    /* Statistics. */
+    long long alloc_cnt;        /* Allocations. */
+    long long free_cnt;         /* Frees. */
+    int slab_cnt;               /* Slabs now allocated. */
+    int max_slab_cnt;           /* Greatest SLAB_CNT. */
+    int in_use;                 /* Objects now allocated. */
+    int max_in_use;             /* Greatest IN_USE. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name,
+                      size_t obj_size, slab_ctor *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,728 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
+
+/* Multiprocessor support.
+
+   The BIOS describes the system's CPUs in the MP configuration
+   table defined by the Intel MultiProcessor Specification,
+   version 1.4, which both Bochs and QEMU provide.  smp_init()
+   reads it to learn how many CPUs there are and their local APIC
+   IDs, and maps the local APICs' registers.  Once the boot CPU
+   is running threads, smp_start() starts the others, the
+   application processors (APs), with the INIT-SIPI-SIPI sequence
+   and the real-mode startup code in ap-start.S.  Each AP runs an
+   idle thread of its own, takes timer ticks from its local APIC
+   timer, and runs threads from its own run queue or steals them
+   from other CPUs' (see thread.c).  The PICs' interrupts,
+   including the PIT ticks that devices/timer.c counts, all
+   still go to the boot CPU.
+
+   Most of the kernel was written for a single CPU, on which
+   disabling interrupts is enough to make a critical section
+   atomic.  That remains true here because a CPU may run kernel
+   code only while it holds the kernel lock, a spin lock that
+   each CPU takes on its way into the kernel and lets go of on
+   its way back to user mode and while its idle thread halts.
+   Thus struct lock, struct semaphore, the scheduler, and
+   everything else that protects itself by disabling interrupts
+   is serialized across CPUs as well.  User processes run on all
+   CPUs in parallel; kernel code does not.
+
+   This is a big kernel lock, and a first step only.  Letting
+   kernel code run on several CPUs at once would take a spin lock
+   beneath each struct semaphore and struct lock, locks for the
+   run queues, and a review of every other critical section that
+   relies on intr_disable(), none of which exists yet.  The
+   spin locks of spinlock.h guard only a few small structures,
+   such as the thread cache and the pools' zeroed pages.
+
+   The kernel lock is a ticket lock, so the CPUs waiting for it
+   get it in turn.  A CPU busy in the kernel also passes the lock
+   to any waiters at the end of each external interrupt, the
+   same points at which it could be preempted on a single CPU,
+   so that a kernel thread that keeps running cannot shut the
+   other CPUs out for good.
+
+   A CPU that spins for the kernel lock still answers TLB
+   shootdown requests, because the holder waits for them with
+   the lock held.  Reschedule IPIs are not waited for. */
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_float
+  {
+    char signature[4];                  /* "_MP_". */
+    uint32_t config_phys;               /* Configuration table. */
+    uint8_t length;                     /* In 16-byte units. */
+    uint8_t spec_rev;                   /* Specification revision. */
+    uint8_t checksum;                   /* Makes bytes sum to 0. */
+    uint8_t features[5];                /* Default configurations. */
+  };
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];                  /* "PCMP". */
+    uint16_t length;                    /* Base table length. */
+    uint8_t spec_rev;                   /* Specification revision. */
+    uint8_t checksum;                   /* Makes bytes sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table_phys;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;                 /* Entries after header. */
+    uint32_t lapic_phys;                /* Local APIC address. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  };
+
+/* MP configuration table processor entry.  See [MP] 4.3.1. */
+struct mp_processor
+  {
+    uint8_t type;                       /* MP_PROCESSOR. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;                      /* MP_CPU_* flags. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  };
+
+/* MP configuration table entry types. */
+#define MP_PROCESSOR 0                  /* 20 bytes. */
+#define MP_BUS 1                        /* 8 bytes. */
+#define MP_IOAPIC 2                     /* 8 bytes. */
+#define MP_IOINTR 3                     /* 8 bytes. */
+#define MP_LINTR 4                      /* 8 bytes. */
+
+/* Processor entry flags. */
+#define MP_CPU_ENABLED 0x01             /* Usable. */
+#define MP_CPU_BSP 0x02                 /* Boot processor. */
+
+/* Local APIC registers, as offsets from lapic_phys.  See
+   [IA32-v3a] 10.4.1 "The Local APIC Block Diagram". */
+#define LAPIC_ID 0x020                  /* Local APIC ID. */
+#define LAPIC_TPR 0x080                 /* Task priority. */
+#define LAPIC_EOI 0x0b0                 /* End of interrupt. */
+#define LAPIC_SVR 0x0f0                 /* Spurious interrupt vector. */
+#define LAPIC_ESR 0x280                 /* Error status. */
+#define LAPIC_ICR_LO 0x300              /* Interrupt command, low half. */
+#define LAPIC_ICR_HI 0x310              /* Interrupt command, high half. */
+#define LAPIC_LVT_TIMER 0x320           /* LVT timer. */
+#define LAPIC_LVT_LINT0 0x350           /* LVT LINT0. */
+#define LAPIC_LVT_LINT1 0x360           /* LVT LINT1. */
+#define LAPIC_LVT_ERROR 0x370           /* LVT error. */
+#define LAPIC_TIMER_INIT 0x380          /* Timer initial count. */
+#define LAPIC_TIMER_CUR 0x390           /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0           /* Timer divide configuration. */
+
+/* Local APIC register bits. */
+#define SVR_ENABLE 0x100                /* APIC software enable. */
+#define LVT_NMI 0x400                   /* Delivery mode NMI. */
+#define LVT_EXTINT 0x700                /* Delivery mode ExtINT. */
+#define LVT_MASKED 0x10000              /* Interrupt masked. */
+#define LVT_PERIODIC 0x20000            /* Timer in periodic mode. */
+#define ICR_INIT 0x500                  /* Delivery mode INIT. */
+#define ICR_STARTUP 0x600               /* Delivery mode STARTUP. */
+#define ICR_PENDING 0x1000              /* Send pending. */
+#define ICR_ASSERT 0x4000               /* Level assert. */
+#define ICR_LEVEL 0x8000                /* Level triggered. */
+#define TIMER_DIV_16 0x3                /* Timer counts bus clock / 16. */
+
+/* CMOS shutdown status byte, which tells the BIOS to send a CPU
+   that gets INIT through the warm reset vector at 40:67.  See
+   [MP] B.4 "Application Processor Startup". */
+#define CMOS_INDEX 0x70
+#define CMOS_DATA 0x71
+#define CMOS_SHUTDOWN 0x0f
+#define SHUTDOWN_WARM_RESET 0x0a
+#define WARM_RESET_VECTOR 0x467
+
+/* Milliseconds to wait for each AP to start. */
+#define AP_START_TIMEOUT 1000
+
+struct cpu cpus[CPU_MAX];
+unsigned cpu_cnt = 1;
+uint32_t lapic_phys;
+
+/* Local APIC registers, mapped at virtual address lapic_phys,
+   or a null pointer if there are no APs to start. */
+static volatile uint32_t *lapic;
+
+/* Local APIC timer counts in one timer tick. */
+static uint32_t lapic_tick_count;
+
+/* Set by the boot CPU, once it has removed the low-memory
+   mapping used by ap-start.S, to let the APs go on. */
+static volatile bool aps_go;
+
+/* The kernel lock.  Each CPU that wants it takes the next
+   ticket and waits until kernel_lock_owner reaches it.  The boot
+   CPU holds ticket 0 from the start. */
+static volatile int kernel_lock_next = 1;       /* Next ticket. */
+static volatile int kernel_lock_owner = 0;      /* Ticket holding lock. */
+static struct cpu *volatile kernel_lock_cpu = &cpus[0]; /* Holder. */
+
+/* Startup code and its parameters, in ap-start.S. */
+extern const char ap_start[], ap_start_end[];
+extern const char ap_pagedir[], ap_stack[], ap_gdtr[], ap_idtr[];
+
+void ap_main (void) NO_RETURN;
+
+/* Returns the kernel lock ticket after TICKET. */
+static inline int
+next_ticket (int ticket) 
+{
+  return (int) ((unsigned) ticket + 1);
+}
+
+static const void *map_phys (uint32_t phys, size_t size);
+static bool checksum_ok (const void *, size_t size);
+static const struct mp_float *find_mp_float (void);
+static const struct mp_float *scan_mp_float (uint32_t phys, size_t size);
+static void add_cpu (const struct mp_processor *);
+static bool map_lapic (void);
+static uint32_t lapic_read (unsigned reg);
+static void lapic_write (unsigned reg, uint32_t value);
+static void lapic_init (bool boot_cpu);
+static void lapic_calibrate (void);
+static void lapic_ipi (uint8_t apic_id, uint32_t icr_lo);
+static bool start_ap (struct cpu *, uint8_t *code);
+static void flush_tlb (void);
+static void tlb_poll (struct cpu *);
+static intr_handler_func lapic_timer_interrupt;
+static intr_handler_func resched_interrupt;
+static intr_handler_func tlb_flush_interrupt;
+
+/* Finds the system's CPUs in the MP configuration table and
+   records them in cpus[].  If there is no usable table, there is
+   just the boot CPU.  If there are others, maps the local APICs'
+   registers for smp_start().  Must be called after
+   vmalloc_init() and before any page directory other than
+   init_page_dir is created. */
+void
+smp_init (void) 
+{
+  const struct mp_float *mpf;
+  const struct mp_config *config;
+  const uint8_t *entry;
+  unsigned found = 0;
+  size_t i;
+
+  cpus[0].started = true;
+
+  mpf = find_mp_float ();
+  if (mpf == NULL || mpf->config_phys == 0)
+    return;
+  config = map_phys (mpf->config_phys, sizeof *config);
+  if (config == NULL
+      || memcmp (config->signature, "PCMP", 4)
+      || map_phys (mpf->config_phys, config->length) == NULL
+      || !checksum_ok (config, config->length))
+    return;
+
+  lapic_phys = config->lapic_phys;
+  entry = (const uint8_t *) (config + 1);
+  for (i = 0; i < config->entry_cnt; i++) 
+    if (*entry == MP_PROCESSOR) 
+      {
+        const struct mp_processor *p = (const void *) entry;
+        if (p->flags & MP_CPU_ENABLED) 
+          {
+            add_cpu (p);
+            found++;
+          }
+        entry += sizeof *p;
+      }
+    else
+      entry += 8;
+
+  printf ("SMP: %u CPUs found, local APIC at %#"PRIx32".\n",
+          found, lapic_phys);
+  if (cpu_cnt > 1 && !map_lapic ()) 
+    {
+      printf ("SMP: cannot map local APIC; using the boot CPU only.\n");
+      cpu_cnt = 1;
+    }
+}
+
+/* Starts the APs found by smp_init(), each on an idle thread of
+   its own, and waits for them to come up.  Must be called by a
+   thread after timer_calibrate() and before any user process
+   starts. */
+void
+smp_start (void) 
+{
+  uint8_t *code = ptov (AP_START_PHYS);
+  unsigned started = 1;
+  unsigned i;
+
+  if (lapic == NULL)
+    return;
+  ASSERT (kernel_lock_held ());
+
+  intr_register_ext (INTR_LAPIC_TIMER, lapic_timer_interrupt,
+                     "Local APIC timer");
+  intr_register_ext (INTR_RESCHED, resched_interrupt, "Reschedule IPI");
+  intr_register_ext (INTR_TLB_FLUSH, tlb_flush_interrupt,
+                     "TLB shootdown IPI");
+  lapic_init (true);
+  lapic_calibrate ();
+
+  /* Copy the startup code to low memory and fill in the
+     parameters that all the APs share.  Map the first 4 MB of
+     physical memory at virtual address 0 too, as start.S did,
+     so that the code keeps running where it is when it turns on
+     paging. */
+  memcpy (code, ap_start, ap_start_end - ap_start);
+  *(uint32_t *) (code + (ap_pagedir - ap_start)) = vtop (init_page_dir);
+  asm volatile ("sgdt (%0)" : : "r" (code + (ap_gdtr - ap_start)) : "memory");
+  asm volatile ("sidt (%0)" : : "r" (code + (ap_idtr - ap_start)) : "memory");
+  init_page_dir[0] = init_page_dir[pd_no (PHYS_BASE)];
+
+  for (i = 1; i < cpu_cnt; i++)
+    if (start_ap (&cpus[i], code))
+      started++;
+
+  /* Take the low mapping away and let the APs, which flush it
+     out of their TLBs, into the kernel. */
+  init_page_dir[0] = 0;
+  flush_tlb ();
+  aps_go = true;
+
+  printf ("SMP: %u of %u CPUs started.\n", started, cpu_cnt);
+}
+
+/* Starts CPU, an AP, running the startup code at CODE, and waits
+   for it to come up.  Returns true if successful. */
+static bool
+start_ap (struct cpu *cpu, uint8_t *code) 
+{
+  uint16_t *warm_reset = ptov (WARM_RESET_VECTOR);
+  void *stack;
+  int i;
+
+  stack = thread_prepare_ap (cpu);
+  if (stack == NULL)
+    return false;
+  *(uint32_t *) (code + (ap_stack - ap_start)) = (uint32_t) stack;
+
+  /* Some BIOSes send a CPU that gets INIT through the warm reset
+     vector instead of leaving it to wait for a STARTUP IPI, so
+     point that at the startup code too. */
+  outb (CMOS_INDEX, CMOS_SHUTDOWN);
+  outb (CMOS_DATA, SHUTDOWN_WARM_RESET);
+  warm_reset[0] = 0;
+  warm_reset[1] = AP_START_PHYS >> 4;
+
+  /* INIT, then two STARTUP IPIs, with the delays that [MP] B.4
+     prescribes.  A STARTUP IPI starts the CPU in real mode at
+     physical address VECTOR << 12. */
+  lapic_ipi (cpu->apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_udelay (200);
+  lapic_ipi (cpu->apic_id, ICR_INIT | ICR_LEVEL);
+  timer_mdelay (10);
+  for (i = 0; i < 2; i++) 
+    {
+      lapic_ipi (cpu->apic_id, ICR_STARTUP | (AP_START_PHYS >> PGBITS));
+      timer_udelay (200);
+    }
+
+  for (i = 0; i < AP_START_TIMEOUT && !cpu->started; i++)
+    timer_mdelay (1);
+  if (!cpu->started) 
+    {
+      printf ("SMP: CPU %u (local APIC %"PRIu8") did not start.\n",
+              cpu->id, cpu->apic_id);
+      return false;
+    }
+  return true;
+}
+
+/* Called by ap-start.S on each AP, with interrupts off, on the
+   stack of the idle thread that thread_prepare_ap() set up for
+   it.  Sets up the CPU and joins in running threads. */
+void
+ap_main (void) 
+{
+  struct cpu *cpu = cpu_current ();
+
+#ifdef USERPROG
+  gdt_load ();
+#endif
+  lapic_init (false);
+  cpu->started = true;
+
+  while (!aps_go)
+    {
+      tlb_poll (cpu);
+      cpu_relax ();
+    }
+  flush_tlb ();
+
+  kernel_lock_acquire ();
+  thread_start_ap ();
+}
+
+/* Acquires the kernel lock for the current CPU, spinning until
+   its turn comes.  While spinning, answers TLB shootdown
+   requests from the holder.  Interrupts must be off. */
+void
+kernel_lock_acquire (void) 
+{
+  struct cpu *cpu = cpu_current ();
+  int ticket;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (kernel_lock_cpu != cpu);
+
+  do
+    ticket = kernel_lock_next;
+  while (atomic_cmpxchg (&kernel_lock_next, ticket, next_ticket (ticket))
+         != ticket);
+  while (kernel_lock_owner != ticket) 
+    {
+      tlb_poll (cpu);
+      cpu_relax ();
+    }
+  kernel_lock_cpu = cpu;
+  tlb_poll (cpu);
+}
+
+/* Releases the kernel lock, which the current CPU must hold.
+   Interrupts must be off, and the CPU must not run kernel code
+   again until it has taken the lock back. */
+void
+kernel_lock_release (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (kernel_lock_held ());
+
+  kernel_lock_cpu = NULL;
+  atomic_xchg (&kernel_lock_owner, next_ticket (kernel_lock_owner));
+}
+
+/* If other CPUs are waiting for the kernel lock, which the
+   current CPU must hold, lets them have it first and then takes
+   it back.  Interrupts must be off, and the caller must be at a
+   point where another CPU's kernel code may run, as it may when
+   a thread is preempted. */
+void
+kernel_lock_relax (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (kernel_lock_held ());
+
+  if (kernel_lock_next != next_ticket (kernel_lock_owner)) 
+    {
+      kernel_lock_release ();
+      kernel_lock_acquire ();
+    }
+}
+
+/* Returns true if the current CPU holds the kernel lock. */
+bool
+kernel_lock_held (void) 
+{
+  return kernel_lock_cpu == cpu_current ();
+}
+
+/* Interrupts CPU, which is running, so that it reconsiders which
+   thread to run. */
+void
+smp_send_resched (struct cpu *cpu) 
+{
+  ASSERT (cpu->started);
+  ASSERT (cpu != cpu_current ());
+
+  lapic_ipi (cpu->apic_id, INTR_RESCHED);
+}
+
+/* Flushes the TLBs of the other CPUs whose active page directory
+   is PD, or of all the other CPUs if PD is a null pointer, as
+   after a change to the kernel's own mappings, and waits until
+   they are done.  The caller must hold the kernel lock and take
+   care of its own TLB. */
+void
+smp_tlb_shootdown (const uint32_t *pd) 
+{
+  struct cpu *self = cpu_current ();
+  unsigned i;
+
+  if (lapic == NULL)
+    return;
+  ASSERT (kernel_lock_held ());
+
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      struct cpu *cpu = &cpus[i];
+      if (cpu != self && cpu->started && (pd == NULL || cpu->pagedir == pd)) 
+        {
+          cpu->tlb_flush = true;
+          lapic_ipi (cpu->apic_id, INTR_TLB_FLUSH);
+        }
+    }
+  for (i = 0; i < cpu_cnt; i++)
+    while (cpus[i].tlb_flush)
+      cpu_relax ();
+}
+
+/* Signals the end of a local APIC interrupt to the current CPU's
+   local APIC. */
+void
+lapic_eoi (void) 
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Flushes the current CPU's TLB by reloading CR3. */
+static void
+flush_tlb (void) 
+{
+  uint32_t cr3;
+
+  asm volatile ("movl %%cr3, %0; movl %0, %%cr3" : "=r" (cr3) : : "memory");
+}
+
+/* Carries out a TLB shootdown requested of CPU, which must be the
+   current CPU, if there is one. */
+static void
+tlb_poll (struct cpu *cpu) 
+{
+  if (cpu->tlb_flush) 
+    {
+      flush_tlb ();
+      cpu->tlb_flush = false;
+    }
+}
+
+/* Local APIC timer interrupt handler, for the APs' timer
+   ticks. */
+static void
+lapic_timer_interrupt (struct intr_frame *args UNUSED) 
+{
+  thread_tick ();
+}
+
+/* Reschedule IPI handler.  Another CPU has put a thread on this
+   CPU's run queue that may need to preempt the running
+   thread. */
+static void
+resched_interrupt (struct intr_frame *args UNUSED) 
+{
+  thread_check_preempt ();
+}
+
+/* TLB shootdown IPI handler.  Usually the shootdown has already
+   been carried out by kernel_lock_acquire(). */
+static void
+tlb_flush_interrupt (struct intr_frame *args UNUSED) 
+{
+  tlb_poll (cpu_current ());
+}
+
+/* Maps the local APICs' registers, which every CPU sees at the
+   same physical address, at the identical virtual address in
+   init_page_dir, with caching off.  Returns false if that
+   address is not free. */
+static bool
+map_lapic (void) 
+{
+  void *vaddr = (void *) lapic_phys;
+  uint32_t *pt;
+
+  if (lapic_phys % PGSIZE != 0
+      || !is_kernel_vaddr (vaddr)
+      || init_page_dir[pd_no (vaddr)] != 0)
+    return false;
+
+  pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  pt[pt_no (vaddr)] = lapic_phys | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+  init_page_dir[pd_no (vaddr)] = pde_create (pt);
+  lapic = vaddr;
+  return true;
+}
+
+/* Returns the value of the current CPU's local APIC register
+   REG. */
+static uint32_t
+lapic_read (unsigned reg) 
+{
+  return lapic[reg / sizeof *lapic];
+}
+
+/* Writes VALUE to the current CPU's local APIC register REG. */
+static void
+lapic_write (unsigned reg, uint32_t value) 
+{
+  lapic[reg / sizeof *lapic] = value;
+
+  /* Wait for the write to finish by reading. */
+  lapic_read (LAPIC_ID);
+}
+
+/* Sets up the current CPU's local APIC.  The boot CPU goes on
+   taking the PICs' interrupts through LINT0 in "virtual wire"
+   mode ([MP] 3.6.2.2) and leaves its APIC timer off, because it
+   has the PIT.  The APs mask LINT0 and LINT1 and take their
+   timer ticks from their APIC timers. */
+static void
+lapic_init (bool boot_cpu) 
+{
+  lapic_write (LAPIC_SVR, SVR_ENABLE | INTR_LAPIC_SPURIOUS);
+  lapic_write (LAPIC_LVT_LINT0, boot_cpu ? LVT_EXTINT : LVT_MASKED);
+  lapic_write (LAPIC_LVT_LINT1, boot_cpu ? LVT_NMI : LVT_MASKED);
+  lapic_write (LAPIC_LVT_ERROR, LVT_MASKED);
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+  if (boot_cpu)
+    lapic_write (LAPIC_LVT_TIMER, LVT_MASKED);
+  else 
+    {
+      lapic_write (LAPIC_LVT_TIMER, LVT_PERIODIC | INTR_LAPIC_TIMER);
+      lapic_write (LAPIC_TIMER_INIT, lapic_tick_count);
+    }
+  lapic_write (LAPIC_TPR, 0);
+}
+
+/* Measures how far the local APIC timer counts in one timer
+   tick against the TSC clock.  All the local APIC timers run off
+   the same bus clock, so the boot CPU measures for all of them. */
+static void
+lapic_calibrate (void) 
+{
+  int64_t start_ns, end_ns;
+  uint32_t counted;
+
+  start_ns = timer_now_ns ();
+  lapic_write (LAPIC_TIMER_INIT, UINT32_MAX);
+  timer_udelay (1000 * 1000 / TIMER_FREQ);
+  counted = UINT32_MAX - lapic_read (LAPIC_TIMER_CUR);
+  end_ns = timer_now_ns ();
+  lapic_write (LAPIC_TIMER_INIT, 0);
+
+  lapic_tick_count = ((uint64_t) counted * (1000 * 1000 * 1000 / TIMER_FREQ)
+                      / (end_ns - start_ns));
+  if (lapic_tick_count == 0)
+    lapic_tick_count = 1;
+}
+
+/* Sends the interprocessor interrupt described by ICR_LO to the
+   CPU whose local APIC ID is APIC_ID, and waits for the local
+   APIC to send it. */
+static void
+lapic_ipi (uint8_t apic_id, uint32_t icr_lo) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, icr_lo);
+  while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+    cpu_relax ();
+  intr_set_level (old_level);
+}
+
+/* Records the CPU described by P in cpus[].  The boot CPU is
+   always cpus[0]. */
+static void
+add_cpu (const struct mp_processor *p) 
+{
+  struct cpu *c;
+
+  if (p->flags & MP_CPU_BSP)
+    c = &cpus[0];
+  else if (cpu_cnt < CPU_MAX) 
+    c = &cpus[cpu_cnt++];
+  else
+    return;
+
+  c->id = c - cpus;
+  c->apic_id = p->apic_id;
+}
+
+/* Returns a kernel virtual address for the SIZE bytes of
+   physical memory starting at PHYS, or a null pointer if they
+   are not all in RAM mapped by the kernel. */
+static const void *
+map_phys (uint32_t phys, size_t size) 
+{
+  uint32_t ram_size = init_ram_pages * PGSIZE;
+
+  if (phys >= ram_size || size > ram_size - phys)
+    return NULL;
+  return ptov (phys);
+}
+
+/* Returns true if the SIZE bytes at P sum to 0 modulo 256. */
+static bool
+checksum_ok (const void *p_, size_t size) 
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Searches the places listed in [MP] 4 for the MP floating
+   pointer structure and returns it, or a null pointer if it is
+   not found. */
+static const struct mp_float *
+find_mp_float (void) 
+{
+  const struct mp_float *mpf;
+  uint16_t ebda_seg = *(const uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(const uint16_t *) ptov (0x413);
+
+  /* First kilobyte of the extended BIOS data area. */
+  if (ebda_seg != 0 && (mpf = scan_mp_float (ebda_seg << 4, 1024)) != NULL)
+    return mpf;
+
+  /* Last kilobyte of base memory. */
+  if (base_kb != 0
+      && (mpf = scan_mp_float ((base_kb - 1) * 1024, 1024)) != NULL)
+    return mpf;
+
+  /* BIOS ROM. */
+  return scan_mp_float (0xf0000, 0x10000);
+}
+
+/* Searches the SIZE bytes of physical memory starting at PHYS
+   for the MP floating pointer structure. */
+static const struct mp_float *
+scan_mp_float (uint32_t phys, size_t size) 
+{
+  const uint8_t *p = map_phys (phys, size);
+  size_t ofs;
+
+  if (p == NULL)
+    return NULL;
+  for (ofs = 0; ofs + sizeof (struct mp_float) <= size; ofs += 16) 
+    {
+      const struct mp_float *mpf = (const void *) (p + ofs);
+      if (!memcmp (mpf->signature, "_MP_", 4)
+          && mpf->length == 1
+          && checksum_ok (mpf, sizeof *mpf))
+        return mpf;
+    }
+  return NULL;
+}
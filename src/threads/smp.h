@@ -0,0 +1,80 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+/* Physical address to which smp_start() copies the application
+   processors' startup code, ap-start.S.  Must be page-aligned,
+   below 1 MB, and clear of everything the loader and start.S
+   left behind that the kernel still uses. */
+#define AP_START_PHYS 0x3000
+
+/* Interrupt vectors of the local APICs' interrupts.  Like the
+   PICs' interrupts, they are external interrupts. */
+#define INTR_LAPIC_FIRST 0xf0           /* First local APIC vector. */
+#define INTR_LAPIC_TIMER 0xf0           /* Local APIC timer. */
+#define INTR_RESCHED 0xf1               /* Reschedule IPI. */
+#define INTR_TLB_FLUSH 0xf2             /* TLB shootdown IPI. */
+#define INTR_LAPIC_SPURIOUS 0xff        /* Spurious interrupt. */
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Maximum number of CPUs supported. */
+#define CPU_MAX 16
+
+/* Per-CPU data.  Each CPU uses only its own struct cpu, except
+   as noted, so members need no locking beyond disabling
+   interrupts. */
+struct cpu
+  {
+    unsigned id;                        /* Index in cpus[]. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    volatile bool started;              /* Running the kernel? */
+    volatile bool tlb_flush;            /* TLB shootdown requested? */
+
+    /* Owned by interrupt.c. */
+    bool in_external_intr;              /* Handling an external interrupt? */
+    bool yield_on_return;               /* Yield on interrupt return? */
+    bool in_softirq;                    /* Running softirqs? */
+
+    /* Owned by thread.c.  Other CPUs may look at these while
+       they hold the kernel lock. */
+    struct thread *idle_thread;         /* Idle thread. */
+    struct thread *running;             /* Running thread. */
+    unsigned thread_ticks;              /* Ticks since last yield. */
+    long long idle_ticks;               /* Ticks spent idle. */
+    long long kernel_ticks;             /* Ticks in kernel threads. */
+    long long user_ticks;               /* Ticks in user programs. */
+    long long switches;                 /* Context switches. */
+
+    /* Owned by userprog/process.c.  Other CPUs may look at it
+       while they hold the kernel lock. */
+    uint32_t *pagedir;                  /* Active page directory, or null. */
+  };
+
+/* CPUs found by smp_init().  cpus[0] is the boot CPU. */
+extern struct cpu cpus[CPU_MAX];
+extern unsigned cpu_cnt;
+
+/* Physical address of the local APICs' registers. */
+extern uint32_t lapic_phys;
+
+void smp_init (void);
+void smp_start (void);
+struct cpu *cpu_current (void);
+
+/* Kernel lock. */
+void kernel_lock_acquire (void);
+void kernel_lock_release (void);
+void kernel_lock_relax (void);
+bool kernel_lock_held (void);
+
+/* Interprocessor interrupts. */
+void smp_send_resched (struct cpu *);
+void smp_tlb_shootdown (const uint32_t *pd);
+void lapic_eoi (void);
+#endif /* __ASSEMBLER__ */
+
+#endif /* threads/smp.h */
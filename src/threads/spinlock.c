@@ -0,0 +1,62 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/cpu.h"
+#include "threads/smp.h"
+
+/* Initializes spin lock L as not held. */
+void
+spinlock_init (struct spinlock *l) 
+{
+  ASSERT (l != NULL);
+
+  l->locked = 0;
+  l->cpu = NULL;
+  l->old_level = INTR_OFF;
+}
+
+/* Acquires spin lock L, spinning until it is available, and
+   disables interrupts until it is released.  L must not already
+   be held by the current CPU: spin locks are not recursive.
+
+   This function may be called from an interrupt handler. */
+void
+spinlock_acquire (struct spinlock *l) 
+{
+  enum intr_level old_level;
+
+  ASSERT (l != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!spinlock_held_by_current_cpu (l));
+  while (atomic_xchg (&l->locked, 1) != 0)
+    while (l->locked)
+      cpu_relax ();
+  l->cpu = cpu_current ();
+  l->old_level = old_level;
+}
+
+/* Releases spin lock L, which the current CPU must hold, and
+   restores the interrupt level from before it was acquired. */
+void
+spinlock_release (struct spinlock *l) 
+{
+  enum intr_level old_level;
+
+  ASSERT (spinlock_held_by_current_cpu (l));
+
+  old_level = l->old_level;
+  l->cpu = NULL;
+  atomic_xchg (&l->locked, 0);
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current CPU holds spin lock L.  (Note that
+   testing whether some other CPU holds a lock would be racy.) */
+bool
+spinlock_held_by_current_cpu (const struct spinlock *l) 
+{
+  ASSERT (l != NULL);
+
+  return l->locked && l->cpu == cpu_current ();
+}
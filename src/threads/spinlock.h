@@ -0,0 +1,29 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+struct cpu;
+
+/* Spin lock.  Unlike struct lock, a spin lock never sleeps, so
+   it may be used with interrupts off and in interrupt handlers.
+   Holding a spin lock disables interrupts on the holding CPU, so
+   on a uniprocessor acquiring one never actually spins. */
+struct spinlock 
+  {
+    volatile int locked;                /* Nonzero while held. */
+    struct cpu *cpu;                    /* Holder, for debugging. */
+    enum intr_level old_level;          /* Level before acquiring. */
+  };
+
+/* Initializer for a static spin lock, for use as
+   "static struct spinlock x = SPINLOCK_INITIALIZER;". */
+#define SPINLOCK_INITIALIZER { 0, NULL, INTR_OFF }
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held_by_current_cpu (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
@@ -27,10 +27,57 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Maximum number of locks that one priority donation propagates
+   through, to bound the time spent walking a chain of nested
+   lock holders. */
+#define DONATION_DEPTH_MAX 8
+
+static bool thread_priority_less (const struct list_elem *,
+                                  const struct list_elem *, void *aux);
+static void donate_priority (struct lock *, int priority);
+static int lock_waiters_priority (struct lock *);
+static void lock_taken (struct lock *);
+static void rwlock_grant (struct rwlock *);
+#ifndef LOCKSTAT
+static void lock_fast_acquired (struct lock *);
+#endif
+
+/* Bits in struct semaphore's `value' member.  The low bits hold
+   the semaphore's value.  SEMA_WAITERS is set while any thread
+   is on the waiter list.
+
+   The fast paths of sema_down() and sema_up() change the value
+   with a single compare-and-swap instead of disabling
+   interrupts, but only when SEMA_WAITERS is clear, so that they
+   can never miss a thread that needs waking up.  Everything else
+   happens in the slow paths, with interrupts off, where ordinary
+   instructions suffice: even on a multiprocessor, only the CPU
+   that holds the kernel lock runs kernel code (see smp.c).
+   Semaphores and locks have no spin locks of their own; they
+   would need them, as would the run queues, before the kernel
+   lock could go. */
+#define SEMA_WAITERS 0x40000000
+#define SEMA_COUNT (SEMA_WAITERS - 1)
+
+#ifdef LOCKSTAT
+/* Lock classes.  A class that does not fit is not counted. */
+#define LOCKSTAT_MAX 64
+static struct lockstat lockstats[LOCKSTAT_MAX];
+static int lockstat_cnt;
+static int lockstat_overflow;   /* Classes that did not fit. */
+
+static struct lockstat *lockstat_find (const char *name);
+static void lockstat_acquired (struct lockstat *, uint64_t wait_start);
+static void lockstat_released (struct lockstat *, uint64_t acquired_tsc);
+#endif
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -45,9 +92,51 @@ void
 sema_init (struct semaphore *sema, unsigned value) 
 {
   ASSERT (sema != NULL);
+  ASSERT (value <= SEMA_COUNT);
 
   sema->value = value;
   list_init (&sema->waiters);
+#ifdef LOCKSTAT
+  sema->stat = NULL;
+#endif
+}
+
+/* Gives SEMA a NAME under which lock statistics count its
+   downs, if LOCKSTAT is defined.  Unnamed semaphores are not
+   counted. */
+void
+sema_set_name (struct semaphore *sema UNUSED, const char *name UNUSED) 
+{
+  ASSERT (sema != NULL);
+  ASSERT (name != NULL);
+
+#ifdef LOCKSTAT
+  sema->stat = lockstat_find (name);
+#endif
+}
+
+/* Decrements SEMA's value without disabling interrupts, if the
+   value is positive and no thread is waiting.  Returns true if
+   successful, false if the caller must take the slow path. */
+static inline bool
+sema_fast_down (struct semaphore *sema) 
+{
+  int value = sema->value;
+
+  return (value > 0 && value < SEMA_WAITERS
+          && atomic_cmpxchg (&sema->value, value, value - 1) == value);
+}
+
+/* Increments SEMA's value without disabling interrupts, if no
+   thread is waiting.  Returns true if successful, false if the
+   caller must take the slow path. */
+static inline bool
+sema_fast_up (struct semaphore *sema) 
+{
+  int value = sema->value;
+
+  return ((value & SEMA_WAITERS) == 0
+          && atomic_cmpxchg (&sema->value, value, value + 1) == value);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -61,20 +150,133 @@ void
 sema_down (struct semaphore *sema) 
 {
   enum intr_level old_level;
+#ifdef LOCKSTAT
+  uint64_t wait_start;
+#endif
 
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
+  /* Lock statistics are only kept on the slow path. */
+#ifndef LOCKSTAT
+  if (sema_fast_down (sema))
+    return;
+#endif
+
   old_level = intr_disable ();
-  while (sema->value == 0) 
+#ifdef LOCKSTAT
+  wait_start = (sema->value & SEMA_COUNT) == 0 ? rdtsc () : 0;
+#endif
+  while ((sema->value & SEMA_COUNT) == 0) 
     {
       list_push_back (&sema->waiters, &thread_current ()->elem);
+      sema->value |= SEMA_WAITERS;
       thread_block ();
     }
   sema->value--;
+#ifdef LOCKSTAT
+  lockstat_acquired (sema->stat, wait_start);
+#endif
   intr_set_level (old_level);
 }
 
+/* A thread waiting in sema_down_timeout(). */
+struct sema_timeout
+  {
+    struct semaphore *sema;     /* Semaphore being waited for. */
+    struct thread *thread;      /* Waiting thread. */
+    bool expired;               /* Woken by the timer? */
+  };
+
+/* Timer callback for sema_down_timeout().  Wakes the thread
+   waiting as described by ST_, unless sema_up() has already
+   taken it off the semaphore's waiter list, so that the thread
+   is woken exactly once. */
+static void
+sema_timeout_expired (void *st_) 
+{
+  struct sema_timeout *st = st_;
+  struct semaphore *sema = st->sema;
+  enum intr_level old_level;
+  struct list_elem *e;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&sema->waiters); e != list_end (&sema->waiters);
+       e = list_next (e))
+    if (e == &st->thread->elem) 
+      {
+        list_remove (e);
+        if (list_empty (&sema->waiters))
+          sema->value &= ~SEMA_WAITERS;
+        st->expired = true;
+        thread_unblock (st->thread);
+        break;
+      }
+  intr_set_level (old_level);
+  thread_check_preempt ();
+}
+
+/* Like sema_down(), but gives up once TICKS timer ticks have
+   passed without SEMA's value becoming positive.  Returns true
+   if SEMA was decremented, false if the wait timed out.  If
+   TICKS is zero or negative, does not wait at all.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t ticks) 
+{
+  struct sema_timeout st;
+  struct timer timer;
+  enum intr_level old_level;
+  bool success;
+#ifdef LOCKSTAT
+  uint64_t wait_start;
+#endif
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+#ifndef LOCKSTAT
+  if (sema_fast_down (sema))
+    return true;
+#endif
+  if (ticks <= 0)
+    return sema_try_down (sema);
+
+  old_level = intr_disable ();
+#ifdef LOCKSTAT
+  wait_start = (sema->value & SEMA_COUNT) == 0 ? rdtsc () : 0;
+#endif
+  st.sema = sema;
+  st.thread = thread_current ();
+  st.expired = false;
+  timer_setup (&timer, sema_timeout_expired, &st);
+  if ((sema->value & SEMA_COUNT) == 0)
+    timer_add (&timer, timer_ticks () + ticks);
+  while ((sema->value & SEMA_COUNT) == 0 && !st.expired) 
+    {
+      list_push_back (&sema->waiters, &st.thread->elem);
+      sema->value |= SEMA_WAITERS;
+      thread_block ();
+    }
+  timer_cancel (&timer);
+
+  /* Take the semaphore even if the timer went off, as long as
+     its value became positive in the meantime. */
+  success = (sema->value & SEMA_COUNT) > 0;
+  if (success)
+    {
+      sema->value--;
+#ifdef LOCKSTAT
+      lockstat_acquired (sema->stat, wait_start);
+#endif
+    }
+  intr_set_level (old_level);
+
+  return success;
+}
+
 /* Down or "P" operation on a semaphore, but only if the
    semaphore is not already 0.  Returns true if the semaphore is
    decremented, false otherwise.
@@ -88,11 +290,19 @@ sema_try_down (struct semaphore *sema)
 
   ASSERT (sema != NULL);
 
+#ifndef LOCKSTAT
+  if (sema_fast_down (sema))
+    return true;
+#endif
+
   old_level = intr_disable ();
-  if (sema->value > 0) 
+  if ((sema->value & SEMA_COUNT) > 0) 
     {
       sema->value--;
       success = true; 
+#ifdef LOCKSTAT
+      lockstat_acquired (sema->stat, 0);
+#endif
     }
   else
     success = false;
@@ -102,7 +312,13 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  If the awakened thread has a higher priority
+   than the running thread, the running thread yields to it.
+
+   Waiters' priorities can change while they wait, because of
+   donation, so the waiter list is kept in arrival order and
+   searched here.
 
    This function may be called from an interrupt handler. */
 void
@@ -112,12 +328,22 @@ sema_up (struct semaphore *sema)
 
   ASSERT (sema != NULL);
 
+  if (sema_fast_up (sema))
+    return;
+
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct list_elem *e = list_max (&sema->waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      if (list_empty (&sema->waiters))
+        sema->value &= ~SEMA_WAITERS;
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
   sema->value++;
   intr_set_level (old_level);
+  thread_check_preempt ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -171,19 +397,32 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   Unlike a semaphore, a lock knows its holder, so a thread that
+   has to wait for a lock donates its priority to the holder (and
+   to the holder of the lock that the holder is waiting for, and
+   so on), so that a high-priority thread is not held up
+   indefinitely by a low-priority one.
+
+   NAME identifies the lock in lock statistics.  Locks with the
+   same name are counted together. */
 void
-lock_init (struct lock *lock)
+lock_init (struct lock *lock, const char *name)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  sema_set_name (&lock->semaphore, name);
+  lock->priority = PRI_MIN - 1;
+  lock->listed = false;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
-   thread.
+   thread.  While waiting, the current thread donates its
+   priority to LOCK's holder.
 
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
@@ -192,14 +431,138 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+#ifndef LOCKSTAT
+  if (sema_fast_down (&lock->semaphore))
+    {
+      lock_fast_acquired (lock);
+      return;
+    }
+#endif
+
+  /* With the fast path, the holder may have taken the semaphore
+     without having set itself as LOCK's holder yet.  There is
+     nobody to donate to then, but we still record what we are
+     waiting for, so that donations to us are passed along. */
+  old_level = intr_disable ();
+  cur->waiting_lock = lock;
+  if (lock->holder != NULL && !thread_mlfqs)
+    donate_priority (lock, cur->priority);
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->waiting_lock = NULL;
+  lock_taken (lock);
+  intr_set_level (old_level);
 }
 
+/* Like lock_acquire(), but gives up once TICKS timer ticks have
+   passed without LOCK becoming available.  Returns true if LOCK
+   was acquired, false if the wait timed out.  A thread that
+   gives up withdraws the priority it donated to LOCK's holder.
+   (Threads further along a chain of nested donations keep it
+   until they release the locks that carried it.)
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (lock));
+
+#ifndef LOCKSTAT
+  if (sema_fast_down (&lock->semaphore))
+    {
+      lock_fast_acquired (lock);
+      return true;
+    }
+#endif
+
+  old_level = intr_disable ();
+  if (ticks > 0)
+    {
+      cur->waiting_lock = lock;
+      if (lock->holder != NULL && !thread_mlfqs)
+        donate_priority (lock, cur->priority);
+    }
+  success = sema_down_timeout (&lock->semaphore, ticks);
+  cur->waiting_lock = NULL;
+  if (success)
+    lock_taken (lock);
+  else if (!thread_mlfqs)
+    {
+      lock->priority = lock_waiters_priority (lock);
+      if (lock->holder != NULL)
+        thread_update_priority (lock->holder);
+    }
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Makes the current thread the holder of LOCK, whose semaphore
+   it has just downed on the slow path, and takes over the
+   donations of the threads still waiting.  Interrupts must be
+   off. */
+static void
+lock_taken (struct lock *lock) 
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+#ifdef LOCKSTAT
+  lock->acquired_tsc = rdtsc ();
+#endif
+  ASSERT (!lock->listed);
+  lock->holder = cur;
+  lock->priority = lock_waiters_priority (lock);
+  list_push_back (&cur->held_locks, &lock->elem);
+  lock->listed = true;
+  thread_update_priority (cur);
+}
+
+#ifndef LOCKSTAT
+/* Finishes acquiring LOCK for the current thread after
+   sema_fast_down() took its semaphore.  A lock can only carry
+   donated priority while threads wait for it, so LOCK goes on
+   the holder's held_locks list only once a thread waits: either
+   donate_priority() puts it there, or, for a thread that began
+   waiting before we set the holder and so could not donate, we
+   do it here. */
+static void
+lock_fast_acquired (struct lock *lock) 
+{
+  struct thread *cur = thread_current ();
+
+  lock->priority = PRI_MIN - 1;
+  lock->holder = cur;
+  barrier ();
+  if (lock->semaphore.value & SEMA_WAITERS)
+    {
+      enum intr_level old_level = intr_disable ();
+      if (!lock->listed) 
+        {
+          lock->priority = lock_waiters_priority (lock);
+          list_push_back (&cur->held_locks, &lock->elem);
+          lock->listed = true;
+          thread_update_priority (cur);
+        }
+      intr_set_level (old_level);
+    }
+}
+#endif
+
 /* Tries to acquires LOCK and returns true if successful or false
    on failure.  The lock must not already be held by the current
    thread.
@@ -209,18 +572,31 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+#ifndef LOCKSTAT
+  if (sema_fast_down (&lock->semaphore))
+    {
+      lock_fast_acquired (lock);
+      return true;
+    }
+#endif
+
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    lock_taken (lock);
+  intr_set_level (old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+   The current thread gives up any priority donated to it through
+   LOCK, and yields if it no longer has the highest priority.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -228,11 +604,41 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* A lock that no thread has waited for is not on our
+     held_locks list and did not raise our priority.  If the
+     fast path fails, a thread has begun waiting meanwhile and
+     may have put LOCK on the list, so take the slow path. */
+#ifndef LOCKSTAT
+  if (!lock->listed)
+    {
+      lock->holder = NULL;
+      barrier ();
+      if (sema_fast_up (&lock->semaphore))
+        return;
+    }
+#endif
+
+  old_level = intr_disable ();
+#ifdef LOCKSTAT
+  lockstat_released (lock->semaphore.stat, lock->acquired_tsc);
+#endif
+  if (lock->listed)
+    {
+      list_remove (&lock->elem);
+      lock->listed = false;
+    }
   lock->holder = NULL;
+  thread_update_priority (cur);
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
+
+  thread_check_preempt ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -245,14 +651,79 @@ lock_held_by_current_thread (const struct lock *lock)
 
   return lock->holder == thread_current ();
 }
+
+/* Donates PRIORITY to the holder of LOCK, then to the holder of
+   the lock that that thread is waiting for, and so on, for at
+   most DONATION_DEPTH_MAX locks.  Stops early once a lock
+   already carries at least PRIORITY, since everything beyond it
+   in the chain then does too.  Interrupts must be off. */
+static void
+donate_priority (struct lock *lock, int priority) 
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; lock != NULL && depth < DONATION_DEPTH_MAX; depth++)
+    {
+      struct thread *holder = lock->holder;
+
+      if (lock->priority >= priority)
+        break;
+      lock->priority = priority;
+      if (holder == NULL)
+        break;
+      if (!lock->listed) 
+        {
+          list_push_back (&holder->held_locks, &lock->elem);
+          lock->listed = true;
+        }
+      thread_update_priority (holder);
+      lock = holder->waiting_lock;
+    }
+}
+
+/* Returns the highest priority among the threads waiting for
+   LOCK, or PRI_MIN - 1 if there are none.  Interrupts must be
+   off. */
+static int
+lock_waiters_priority (struct lock *lock) 
+{
+  struct list *waiters = &lock->semaphore.waiters;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (waiters))
+    return PRI_MIN - 1;
+  e = list_max (waiters, thread_priority_less, NULL);
+  return list_entry (e, struct thread, elem)->priority;
+}
+
+/* Returns true if the thread owning list element A has a lower
+   priority than the one owning B, false otherwise. */
+static bool
+thread_priority_less (const struct list_elem *a_, const struct list_elem *b_,
+                      void *aux UNUSED) 
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority < b->priority;
+}
 
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static bool semaphore_elem_less (const struct list_elem *,
+                                 const struct list_elem *, void *aux);
+static void cond_wake (struct semaphore_elem *, struct lock *);
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -295,21 +766,104 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
+
+  /* cond_wake() may have made us wait for LOCK already. */
+  waiter.thread->waiting_lock = NULL;
   lock_acquire (lock);
 }
 
+/* Like cond_wait(), but gives up waiting for COND to be signaled
+   once TICKS timer ticks have passed.  LOCK is reacquired before
+   returning either way, which may take longer.  Returns true if
+   COND was signaled, false if the wait timed out.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+cond_timedwait (struct condition *cond, struct lock *lock, int64_t ticks) 
+{
+  struct semaphore_elem waiter;
+  bool signaled;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+  
+  sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
+  list_push_back (&cond->waiters, &waiter.elem);
+  lock_release (lock);
+  signaled = sema_down_timeout (&waiter.semaphore, ticks);
+  waiter.thread->waiting_lock = NULL;
+  lock_acquire (lock);
+
+  /* A signal that arrived after the timeout but before we got
+     LOCK back has already taken WAITER off COND's list and upped
+     its semaphore.  Accept it rather than lose it.  Otherwise,
+     WAITER is still on the list, where only LOCK's holder may
+     touch it. */
+  if (!signaled)
+    {
+      signaled = sema_try_down (&waiter.semaphore);
+      if (!signaled)
+        list_remove (&waiter.elem);
+    }
+  return signaled;
+}
+
+/* Wakes the thread waiting on WAITER for a condition variable
+   protected by LOCK, which the current thread holds.
+
+   If that thread has already blocked, waking it would only let
+   it run long enough to find LOCK held and block again.  Instead,
+   this function moves it straight from WAITER's semaphore to
+   LOCK's waiter list, a technique called "wait morphing", and
+   raises WAITER's semaphore without waking it.  Releasing LOCK
+   then wakes it, and it returns from sema_down() in cond_wait()
+   and takes LOCK.  Thus, cond_broadcast() with N waiters wakes
+   them one at a time, as LOCK is passed along, instead of all at
+   once. */
+static void
+cond_wake (struct semaphore_elem *waiter, struct lock *lock) 
+{
+  struct semaphore *sema = &waiter->semaphore;
+  struct thread *t = waiter->thread;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (list_empty (&sema->waiters))
+    {
+      /* Not blocked yet, so an ordinary wakeup costs nothing. */
+      intr_set_level (old_level);
+      sema_up (sema);
+      return;
+    }
+
+  list_remove (&t->elem);
+  sema->value = 1;
+  list_push_back (&lock->semaphore.waiters, &t->elem);
+  lock->semaphore.value |= SEMA_WAITERS;
+  t->waiting_lock = lock;
+  if (!thread_mlfqs)
+    donate_priority (lock, t->priority);
+  intr_set_level (old_level);
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one of them to
+   wake up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
    interrupt handler. */
 void
-cond_signal (struct condition *cond, struct lock *lock UNUSED) 
+cond_signal (struct condition *cond, struct lock *lock) 
 {
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -317,12 +871,18 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_max (&cond->waiters,
+                                      semaphore_elem_less, NULL);
+      list_remove (e);
+      cond_wake (list_entry (e, struct semaphore_elem, elem), lock);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
-   LOCK).  LOCK must be held before calling this function.
+   LOCK).  LOCK must be held before calling this function.  The
+   threads actually run one at a time, as each releases LOCK; see
+   cond_wake().
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -336,3 +896,370 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Returns true if the thread waiting on semaphore_elem A has a
+   lower priority than the one waiting on B, false otherwise. */
+static bool
+semaphore_elem_less (const struct list_elem *a_, const struct list_elem *b_,
+                     void *aux UNUSED) 
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem, elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem, elem);
+
+  return a->thread->priority < b->thread->priority;
+}
+
+/* Initializes RW.  A reader-writer lock can be held either by
+   any number of readers at once or by a single writer.
+
+   Writers are preferred: once a writer is waiting, new readers
+   wait too, so that a steady stream of readers cannot starve
+   writers.  When the lock comes free and writers are waiting,
+   it goes to the highest-priority writer; otherwise, all the
+   waiting readers get it at once.  The lock is handed directly
+   to the threads it wakes, so they never find it taken again.
+
+   Unlike a lock, a reader-writer lock does not donate priority
+   to the threads holding it, since it may have many of them.
+
+   NAME identifies RW in lock statistics, which count reads and
+   writes together but hold times only for writes. */
+void
+rwlock_init (struct rwlock *rw, const char *name UNUSED) 
+{
+  ASSERT (rw != NULL);
+  ASSERT (name != NULL);
+
+  rw->readers = 0;
+  rw->writer = NULL;
+  list_init (&rw->read_waiters);
+  list_init (&rw->write_waiters);
+#ifdef LOCKSTAT
+  rw->stat = lockstat_find (name);
+#endif
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it or
+   waits for it if necessary.  The current thread must not
+   already hold RW for writing.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer != NULL || !list_empty (&rw->write_waiters))
+    {
+#ifdef LOCKSTAT
+      uint64_t wait_start = rdtsc ();
+#endif
+      /* rwlock_grant() counts us as a reader before waking us. */
+      list_push_back (&rw->read_waiters, &thread_current ()->elem);
+      thread_block ();
+#ifdef LOCKSTAT
+      lockstat_acquired (rw->stat, wait_start);
+#endif
+    }
+  else
+    {
+      rw->readers++;
+#ifdef LOCKSTAT
+      lockstat_acquired (rw->stat, 0);
+#endif
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns
+   true if successful, false if a writer holds or waits for RW.
+
+   This function will not sleep, so it may be called within an
+   interrupt handler. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && list_empty (&rw->write_waiters);
+  if (success)
+    {
+      rw->readers++;
+#ifdef LOCKSTAT
+      lockstat_acquired (rw->stat, 0);
+#endif
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for
+   reading. */
+void
+rwlock_release_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw->readers > 0);
+
+  old_level = intr_disable ();
+  if (--rw->readers == 0)
+    rwlock_grant (rw);
+  intr_set_level (old_level);
+
+  thread_check_preempt ();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it if necessary.  The current thread must not already hold
+   RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer != NULL || rw->readers > 0)
+    {
+#ifdef LOCKSTAT
+      uint64_t wait_start = rdtsc ();
+#endif
+      /* rwlock_grant() makes us the writer before waking us. */
+      list_push_back (&rw->write_waiters, &cur->elem);
+      thread_block ();
+#ifdef LOCKSTAT
+      lockstat_acquired (rw->stat, wait_start);
+#endif
+    }
+  else
+    {
+      rw->writer = cur;
+#ifdef LOCKSTAT
+      lockstat_acquired (rw->stat, 0);
+#endif
+    }
+#ifdef LOCKSTAT
+  rw->acquired_tsc = rdtsc ();
+#endif
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing without sleeping.  Returns
+   true if successful, false if any thread holds RW. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && rw->readers == 0;
+  if (success)
+    {
+      rw->writer = thread_current ();
+#ifdef LOCKSTAT
+      lockstat_acquired (rw->stat, 0);
+      rw->acquired_tsc = rdtsc ();
+#endif
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for
+   writing. */
+void
+rwlock_release_write (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+#ifdef LOCKSTAT
+  lockstat_released (rw->stat, rw->acquired_tsc);
+#endif
+  rw->writer = NULL;
+  rwlock_grant (rw);
+  intr_set_level (old_level);
+
+  thread_check_preempt ();
+}
+
+/* Returns true if the current thread holds RW for writing,
+   false otherwise.  There is no way to tell which threads hold a
+   reader-writer lock for reading. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Hands RW, which no thread holds, to the highest-priority
+   waiting writer if there is one, or else to all the waiting
+   readers.  Interrupts must be off. */
+static void
+rwlock_grant (struct rwlock *rw) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (rw->writer == NULL && rw->readers == 0);
+
+  if (!list_empty (&rw->write_waiters)) 
+    {
+      struct list_elem *e = list_max (&rw->write_waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      rw->writer = list_entry (e, struct thread, elem);
+      thread_unblock (rw->writer);
+    }
+  else
+    while (!list_empty (&rw->read_waiters)) 
+      {
+        struct list_elem *e = list_pop_front (&rw->read_waiters);
+        rw->readers++;
+        thread_unblock (list_entry (e, struct thread, elem));
+      }
+}
+
+#ifdef LOCKSTAT
+/* Returns the statistics for the lock class named NAME, creating
+   them if necessary, or a null pointer if there are already
+   LOCKSTAT_MAX classes. */
+static struct lockstat *
+lockstat_find (const char *name) 
+{
+  struct lockstat *s = NULL;
+  enum intr_level old_level;
+  int i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < lockstat_cnt; i++)
+    if (!strcmp (lockstats[i].name, name)) 
+      {
+        s = &lockstats[i];
+        break;
+      }
+  if (s == NULL)
+    {
+      if (lockstat_cnt < LOCKSTAT_MAX)
+        {
+          s = &lockstats[lockstat_cnt++];
+          memset (s, 0, sizeof *s);
+          s->name = name;
+        }
+      else
+        lockstat_overflow++;
+    }
+  intr_set_level (old_level);
+
+  return s;
+}
+
+/* Counts an acquisition in S, if S is non-null.  If the
+   acquisition had to wait, WAIT_START is when the wait began;
+   otherwise it is 0.  Interrupts must be off. */
+static void
+lockstat_acquired (struct lockstat *s, uint64_t wait_start) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (s == NULL)
+    return;
+  s->acquired++;
+  if (wait_start != 0)
+    {
+      uint64_t wait = rdtsc () - wait_start;
+      s->contended++;
+      s->wait_tsc += wait;
+      if (wait > s->max_wait_tsc)
+        s->max_wait_tsc = wait;
+    }
+}
+
+/* Counts the time since ACQUIRED_TSC as hold time in S, if S is
+   non-null.  Interrupts must be off. */
+static void
+lockstat_released (struct lockstat *s, uint64_t acquired_tsc) 
+{
+  uint64_t hold;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (s == NULL)
+    return;
+  hold = rdtsc () - acquired_tsc;
+  s->hold_tsc += hold;
+  if (hold > s->max_hold_tsc)
+    s->max_hold_tsc = hold;
+}
+
+/* Prints lock statistics for each lock class, in decreasing
+   order of total time spent waiting. */
+void
+lockstat_print (void) 
+{
+  uint8_t order[LOCKSTAT_MAX];
+  enum intr_level old_level;
+  int cnt, i, j;
+
+  /* Insertion sort by total wait. */
+  old_level = intr_disable ();
+  cnt = lockstat_cnt;
+  for (i = 0; i < cnt; i++)
+    {
+      for (j = i; j > 0; j--)
+        if (lockstats[order[j - 1]].wait_tsc < lockstats[i].wait_tsc)
+          order[j] = order[j - 1];
+        else
+          break;
+      order[j] = i;
+    }
+  intr_set_level (old_level);
+
+  printf ("Lock statistics (TSC cycles), by total wait:\n");
+  printf ("%-16s %10s %10s %14s %12s %14s %12s\n", "name", "acquired",
+          "contended", "wait", "max wait", "hold", "max hold");
+  for (i = 0; i < cnt; i++) 
+    {
+      const struct lockstat *s = &lockstats[order[i]];
+      printf ("%-16s %10lld %10lld %14"PRIu64" %12"PRIu64
+              " %14"PRIu64" %12"PRIu64"\n",
+              s->name, s->acquired, s->contended, s->wait_tsc,
+              s->max_wait_tsc, s->hold_tsc, s->max_hold_tsc);
+    }
+  if (lockstat_overflow > 0)
+    printf ("%d lock classes not counted.\n", lockstat_overflow);
+}
+#else /* !LOCKSTAT */
+/* Prints a note that lock statistics are not compiled in. */
+void
+lockstat_print (void) 
+{
+  printf ("Lock statistics not compiled in; define LOCKSTAT.\n");
+}
+#endif /* !LOCKSTAT */
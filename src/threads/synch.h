@@ -3,16 +3,42 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef LOCKSTAT
+/* Contention statistics for a class of locks, that is, all the
+   locks, semaphores, or reader-writer locks initialized with the
+   same name.  Compiled in only if LOCKSTAT is defined, e.g. by
+   adding -DLOCKSTAT to DEFINES in Make.vars.  Times are in TSC
+   cycles. */
+struct lockstat 
+  {
+    const char *name;           /* Class name. */
+    long long acquired;         /* Acquisitions. */
+    long long contended;        /* Acquisitions that had to wait. */
+    uint64_t wait_tsc;          /* Total time spent waiting. */
+    uint64_t max_wait_tsc;      /* Longest wait. */
+    uint64_t hold_tsc;          /* Total time held. */
+    uint64_t max_hold_tsc;      /* Longest hold. */
+  };
+#endif
+
+void lockstat_print (void);
 
 /* A counting semaphore. */
 struct semaphore 
   {
-    unsigned value;             /* Current value. */
+    volatile int value;         /* Current value, plus SEMA_WAITERS. */
     struct list waiters;        /* List of waiting threads. */
+#ifdef LOCKSTAT
+    struct lockstat *stat;      /* Statistics, or null if unnamed. */
+#endif
   };
 
 void sema_init (struct semaphore *, unsigned value);
+void sema_set_name (struct semaphore *, const char *name);
 void sema_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t ticks);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
@@ -20,12 +46,19 @@ void sema_self_test (void);
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks list. */
+    int priority;               /* Highest priority donated via this lock. */
+    bool listed;                /* In holder's held_locks? */
+#ifdef LOCKSTAT
+    uint64_t acquired_tsc;      /* When the holder acquired it. */
+#endif
   };
 
-void lock_init (struct lock *);
+void lock_init (struct lock *, const char *name);
 void lock_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t ticks);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
@@ -38,9 +71,32 @@ struct condition
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_timedwait (struct condition *, struct lock *, int64_t ticks);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock. */
+struct rwlock 
+  {
+    int readers;                /* Number of readers holding it. */
+    struct thread *writer;      /* Writer holding it, or null. */
+    struct list read_waiters;   /* Threads waiting to read. */
+    struct list write_waiters;  /* Threads waiting to write. */
+#ifdef LOCKSTAT
+    struct lockstat *stat;      /* Statistics. */
+    uint64_t acquired_tsc;      /* When the writer acquired it. */
+#endif
+  };
+
+void rwlock_init (struct rwlock *, const char *name);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -1,16 +1,23 @@
 #include "threads/thread.h"
 #include <debug.h>
 #include <stddef.h>
+#include <console.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/sched.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -20,22 +27,61 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Scheduling class for each policy.  The classes own the run
+   queues of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  The normal
+   class is chosen by thread_set_sched().
+
+   Each CPU has run queues of its own, indexed by CPU id, and a
+   ready thread is on the run queue of its `cpu'.  A thread that
+   becomes ready goes back to the CPU that last ran it, unless
+   that CPU is busy and another is idle (see select_cpu()).  A
+   CPU that runs out of ready threads steals one from the CPU
+   with the most (see steal_ready()). */
+static const struct sched_class *classes[SCHED_POLICY_CNT] =
+  {&sched_edf, &sched_priority, &sched_idle};
+static int ready_cnt[CPU_MAX];  /* Number of threads in run queues. */
+static int policy_ready_cnt[CPU_MAX][SCHED_POLICY_CNT]; /* Per policy. */
+
+/* Run queues for the priority and MLFQS classes.  There is one
+   FIFO list per priority level, and bit N of ready_mask is set
+   if and only if ready_queues[N] is nonempty, so that finding
+   the highest-priority ready thread takes one bit scan no matter
+   how many threads are ready. */
+static struct list ready_queues[CPU_MAX][PRI_MAX + 1];
+static uint64_t ready_mask[CPU_MAX];
+
+/* Run queues for the round-robin class. */
+static struct list rr_queue[CPU_MAX];
+
+/* Run queues for the idle class. */
+static struct list idle_queue[CPU_MAX];
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+static int all_cnt;             /* Number of threads in all_list. */
+
+/* Dying threads that the reaper thread has yet to look at.
+   Each thread that dies is appended to dead_list and "up"s
+   reap_sema.  See reaper() for details. */
+static struct list dead_list;
+static struct semaphore reap_sema;
+
+/* Cache of free thread pages.  Pages of reaped threads go here
+   first, so that thread_create() can usually skip the page
+   allocator.  The cached pages are chained through their first
+   word.  Protected by thread_cache_lock. */
+#define THREAD_CACHE_SIZE 8
+static void *thread_cache;
+static size_t thread_cache_cnt;
+static struct spinlock thread_cache_lock = SPINLOCK_INITIALIZER;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+static struct spinlock tid_lock = SPINLOCK_INITIALIZER;
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -45,29 +91,75 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+/* Histogram of wakeup-to-run latency, that is, the TSC cycles
+   from thread_unblock() until the thread next runs.  Bucket 0
+   counts latencies under 2 cycles, bucket N counts latencies in
+   [2**N, 2**(N+1)), and the last bucket also counts everything
+   longer. */
+#define LATENCY_BUCKETS 40
+static long long latency_hist[LATENCY_BUCKETS];
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
-/* If false (default), use round-robin scheduler.
-   If true, use multi-level feedback queue scheduler.
-   Controlled by kernel command-line option "-o mlfqs". */
+/* True if the multi-level feedback queue scheduling class is
+   in use.  Set by thread_set_sched(). */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler state.
+
+   The running thread's recent_cpu grows by one on every tick,
+   and its priority is recomputed every fourth tick.  No other
+   thread's recent_cpu or niceness changes between the
+   once-per-second updates, so neither do their priorities, and
+   the per-tick work never has to look at any thread but the
+   running one.
+
+   Once per second, load_avg is updated and every thread's
+   recent_cpu is decayed and its priority recomputed.  Rather
+   than walking all of all_list inside a single timer interrupt,
+   which would keep interrupts off for time proportional to the
+   number of threads, the walk is spread over up to
+   MLFQS_SPREAD_TICKS ticks: each tick handles the next batch of
+   threads starting at mlfqs_cursor.  thread_exit() steps the
+   cursor past a thread that leaves all_list under it. */
+#define MLFQS_SPREAD_TICKS (TIMER_FREQ / 4)
+#define MLFQS_BATCH_MIN 16
+static fixed_t load_avg;                /* System load average. */
+static fixed_t mlfqs_decay;             /* Decay factor for current pass. */
+static struct list_elem *mlfqs_cursor;  /* Next thread in pass, or null. */
+static int mlfqs_batch;                 /* Threads to update per tick. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
+static void reaper (void *aux UNUSED);
+static void *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static tid_t create_thread (const char *name, int priority,
+                            enum sched_policy, int runtime, int period,
+                            thread_func *, void *aux);
+static bool should_preempt (const struct thread *cur);
+static bool is_idle_thread (const struct thread *);
+static bool cpu_idle (const struct cpu *);
+static int ready_total (void);
+static struct cpu *select_cpu (const struct thread *);
+static struct thread *pick_ready (struct cpu *);
+static struct thread *steal_ready (struct cpu *thief);
+static struct thread *next_thread_to_run (struct cpu *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static void account_state (struct thread *, uint64_t now);
 static void init_thread (struct thread *, const char *name, int priority);
+static void change_priority (struct thread *, int priority);
+static void mlfqs_update_recent_cpu (struct thread *);
+static int mlfqs_priority (const struct thread *);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static void print_thread_stats (struct thread *, void *aux);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 
@@ -87,21 +179,27 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  enum sched_policy policy;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  list_init (&dead_list);
+  sema_init (&reap_sema, 0);
+  for (policy = 0; policy < SCHED_POLICY_CNT; policy++)
+    classes[policy]->init ();
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
+  initial_thread->cpu = &cpus[0];
   initial_thread->tid = allocate_tid ();
+  cpus[0].running = initial_thread;
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
-   Also creates the idle thread. */
+   Also creates the idle and reaper threads. */
 void
 thread_start (void) 
 {
@@ -110,10 +208,15 @@ thread_start (void)
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
+  /* Create the reaper thread.  It mostly sleeps, so give it the
+     top priority to keep dead threads from piling up. */
+  thread_create ("reaper", PRI_MAX, reaper, NULL);
+
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize its CPU's
+     idle_thread. */
   sema_down (&idle_started);
 }
 
@@ -123,28 +226,141 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *cpu = t->cpu;
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == cpu->idle_thread)
+    cpu->idle_ticks++;
 #ifdef USERPROG
-  else if (t->pagedir != NULL)
-    user_ticks++;
+  else if (t->process != NULL)
+    cpu->user_ticks++;
 #endif
   else
-    kernel_ticks++;
+    cpu->kernel_ticks++;
+
+  /* The normal class's bookkeeping, such as the MLFQS load
+     average, must happen on every tick. */
+  if (classes[SCHED_NORMAL]->tick != NULL)
+    classes[SCHED_NORMAL]->tick (t);
+  if (t->policy != SCHED_NORMAL && classes[t->policy]->tick != NULL)
+    classes[t->policy]->tick (t);
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++cpu->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
-/* Prints thread statistics. */
+/* Accounts for a timer tick that passed while the CPUs were
+   idle and devices/timer.c had the timer interrupt switched
+   off.  thread_tick_deadline() guarantees that such a tick has
+   no work to do other than counting it.  The tick is the boot
+   CPU's, since the APs' timers never stop.  Interrupts must be
+   off. */
+void
+thread_tick_idle (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  cpus[0].idle_ticks++;
+}
+
+/* Returns the first timer tick after tick NOW at which
+   thread_tick() has work to do even if the CPU stays idle, or
+   INT64_MAX if there is no such tick.  Only some scheduling
+   classes, such as the MLFQS, have such work. */
+int64_t
+thread_tick_deadline (int64_t now) 
+{
+  if (classes[SCHED_NORMAL]->tick_deadline != NULL)
+    return classes[SCHED_NORMAL]->tick_deadline (now);
+  else
+    return INT64_MAX;
+}
+
+/* Returns true if every CPU is idle, that is, if each CPU is
+   running its idle thread and no other thread is ready to run. */
+bool
+thread_cpus_idle (void) 
+{
+  unsigned i;
+
+  if (ready_total () != 0)
+    return false;
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].running != NULL && !is_idle_thread (cpus[i].running))
+      return false;
+  return true;
+}
+
+/* Prints thread statistics: tick counts summed over all CPUs,
+   then the time each live thread has spent running, ready, and
+   blocked, then the wakeup-to-run latency histogram. */
 void
 thread_print_stats (void) 
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  enum intr_level old_level;
+  unsigned i;
+
+  /* Take the console lock first, so that printing never blocks
+     while interrupts are off and all_list could change. */
+  acquire_console ();
+  old_level = intr_disable ();
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      idle_ticks += cpus[i].idle_ticks;
+      kernel_ticks += cpus[i].kernel_ticks;
+      user_ticks += cpus[i].user_ticks;
+    }
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  thread_foreach (print_thread_stats, NULL);
+  printf ("Wakeup latency (cycles):");
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    if (latency_hist[i] != 0)
+      printf (" %s%llu:%lld", i == LATENCY_BUCKETS - 1 ? ">=" : "",
+              (unsigned long long) 1 << i, latency_hist[i]);
+  printf ("\n");
+  intr_set_level (old_level);
+  release_console ();
+}
+
+/* Prints T's line of thread_print_stats() output. */
+static void
+print_thread_stats (struct thread *t, void *aux UNUSED) 
+{
+  printf ("Thread %d (%s): %llu run, %llu ready, %llu blocked cycles\n",
+          t->tid, t->name, t->run_tsc, t->ready_tsc, t->blocked_tsc);
+}
+
+/* Returns the number of timer ticks spent in the idle threads
+   of all CPUs since boot. */
+int64_t
+thread_get_idle_ticks (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t t = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    t += cpus[i].idle_ticks;
+  intr_set_level (old_level);
+  return t;
+}
+
+/* Returns the number of context switches on all CPUs since
+   boot. */
+long long
+thread_get_switch_cnt (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  long long cnt = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    cnt += cpus[i].switches;
+  intr_set_level (old_level);
+  return cnt;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -159,29 +375,89 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, the new thread runs before thread_create() returns. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
+{
+  return create_thread (name, priority, SCHED_NORMAL, 0, 0, function, aux);
+}
+
+/* Like thread_create(), but the new thread is a real-time
+   thread with the SCHED_EDF policy, which reserves RUNTIME ticks
+   of CPU time in every PERIOD ticks.  Returns TID_ERROR if the
+   reservation would overcommit the CPU.  The new thread runs
+   before any thread with another policy. */
+tid_t
+thread_create_edf (const char *name, int runtime, int period,
+                   thread_func *function, void *aux) 
+{
+  ASSERT (0 < runtime && runtime <= period);
+
+  return create_thread (name, PRI_DEFAULT, SCHED_EDF, runtime, period,
+                        function, aux);
+}
+
+/* Like thread_create(), but the new thread has the SCHED_IDLE
+   policy, so that it runs only when no other thread is ready.
+   Suited to background work such as flushing and scrubbing.
+   Priority donation does not lift a thread out of SCHED_IDLE,
+   so it should not hold locks that busier threads need. */
+tid_t
+thread_create_idle (const char *name, thread_func *function, void *aux) 
+{
+  return create_thread (name, PRI_MIN, SCHED_IDLE, 0, 0, function, aux);
+}
+
+/* Creates a thread for thread_create() and its variants, with
+   scheduling POLICY and, for SCHED_EDF, a reservation of RUNTIME
+   ticks every PERIOD ticks. */
+static tid_t
+create_thread (const char *name, int priority, enum sched_policy policy,
+               int runtime, int period, thread_func *function, void *aux) 
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
-  /* Initialize thread. */
+  /* Reserve CPU time for an EDF thread. */
+  if (policy == SCHED_EDF)
+    {
+      old_level = intr_disable ();
+      if (!sched_edf_reserve (runtime, period))
+        {
+          free_thread_page (t);
+          intr_set_level (old_level);
+          return TID_ERROR;
+        }
+      intr_set_level (old_level);
+    }
+
+  /* Initialize thread.  The scheduling class may derive some of
+     its state from its parent's.  Under the MLFQS, for example, a
+     new thread inherits its parent's niceness and recent_cpu, and
+     its priority is derived from them rather than taken from
+     PRIORITY. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  old_level = intr_disable ();
+  if (classes[SCHED_NORMAL]->fork != NULL)
+    classes[SCHED_NORMAL]->fork (t, thread_current ());
+  if (policy == SCHED_EDF)
+    sched_edf_attach (t, runtime, period);
+  t->policy = policy;
+  intr_set_level (old_level);
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -206,7 +482,11 @@ thread_create (const char *name, int priority,
   t->exit_status = 0;
   t->wait_status = false;
   t->is_terminated = false;
-  list_push_back(&t->parent->children, &t->child_elem);
+  process_add_child (t);
+#else
+  /* Nobody waits for a kernel thread, so it can be reaped as
+     soon as it dies. */
+  t->detached = true;
 #endif
 
   /* Add to run queue. */
@@ -235,10 +515,12 @@ thread_block (void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   If T has a higher priority than the running thread, the
+   running thread is preempted, but only if that is safe: if the
+   caller had disabled interrupts itself, it may expect that it
+   can atomically unblock a thread and update other data, so in
+   that case the caller must call thread_check_preempt() itself
+   once it re-enables interrupts. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -248,9 +530,15 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  t->cpu = select_cpu (t);
+  ready_push (t);
+  account_state (t, rdtsc ());
   t->status = THREAD_READY;
+  t->woken = true;
   intr_set_level (old_level);
+
+  if (old_level == INTR_ON || intr_context ())
+    thread_check_preempt ();
 }
 
 /* Returns the name of the running thread. */
@@ -296,17 +584,51 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  malloc_thread_exit ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
+  if (thread_current ()->edf_period != 0)
+    sched_edf_detach (thread_current ());
+  if (mlfqs_cursor == &thread_current ()->allelem)
+    {
+      mlfqs_cursor = list_next (mlfqs_cursor);
+      if (mlfqs_cursor == list_end (&all_list))
+        mlfqs_cursor = NULL;
+    }
   list_remove (&thread_current()->allelem);
+  all_cnt--;
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
 }
 
+/* Gives up the caller's claim on thread T, which need not have
+   exited yet.  T's page will be freed once T has died and the
+   reaper has cleaned up after it, or right away if that has
+   already happened.  T must not be used after this call.
+
+   A user process's parent releases it after collecting its exit
+   status, or when the parent itself exits.  Kernel threads
+   created without USERPROG start out released. */
+void
+thread_release (struct thread *t) 
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  ASSERT (!t->detached);
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_ZOMBIE)
+    free_thread_page (t);
+  else
+    t->detached = true;
+  intr_set_level (old_level);
+}
+
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
 void
@@ -318,13 +640,61 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+  if (!is_idle_thread (cur)) 
+    ready_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if some ready thread should preempt the running
+   thread, as decided by should_preempt().  In an external
+   interrupt handler, the yield is deferred until the interrupt
+   returns.  Does nothing if interrupts are off outside an
+   interrupt handler, because then the caller is in the middle of
+   something atomic. */
+void
+thread_check_preempt (void) 
+{
+  enum intr_level old_level;
+  bool preempt;
+
+  if (!intr_context () && intr_get_level () == INTR_OFF)
+    return;
+
+  old_level = intr_disable ();
+  preempt = should_preempt (thread_current ());
+  intr_set_level (old_level);
+
+  if (preempt)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
+}
+
+/* Returns true if a thread ready on CUR's CPU should preempt
+   CUR, which is running there: if a thread with a policy of
+   higher precedence than CUR's is ready, or if CUR's scheduling
+   class says so, which for the priority-based classes means that
+   a thread with a higher priority is ready.  Interrupts must be
+   off. */
+static bool
+should_preempt (const struct thread *cur) 
+{
+  unsigned id = cur->cpu->id;
+  enum sched_policy policy;
+
+  if (is_idle_thread (cur))
+    return ready_cnt[id] > 0;
+  for (policy = 0; policy < cur->policy; policy++)
+    if (policy_ready_cnt[id][policy] > 0)
+      return true;
+  return classes[cur->policy]->preempt (cur);
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -342,73 +712,369 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY.  The
+   thread keeps running at any higher priority donated to it
+   through the locks it holds.  Yields if that leaves a ready
+   thread with a higher priority.  Ignored under the MLFQS, which
+   computes priorities itself. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_update_priority (cur);
+  intr_set_level (old_level);
+
+  thread_check_preempt ();
+}
+
+/* Recomputes T's effective priority as the larger of its base
+   priority and the highest priority donated through any lock T
+   holds, moving T to the matching run queue if it is ready.
+   Takes time proportional to the number of locks T holds.  Does
+   nothing under the MLFQS, which has no donation.  Interrupts
+   must be off. */
+void
+thread_update_priority (struct thread *t) 
+{
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      if (lock->priority > priority)
+        priority = lock->priority;
+    }
+  change_priority (t, priority);
 }
 
-/* Returns the current thread's priority. */
+/* Returns the current thread's effective priority. */
 int
 thread_get_priority (void) 
 {
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority, and yields if it no longer has the highest
+   priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    cur->priority = mlfqs_priority (cur);
+  intr_set_level (old_level);
+
+  thread_check_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
+}
+
+/* Sets the current thread's number of tickets, which sets its
+   share of the CPU under stride scheduling, to TICKETS. */
+void
+thread_set_tickets (int tickets) 
+{
+  ASSERT (TICKETS_MIN <= tickets && tickets <= TICKETS_MAX);
+
+  thread_current ()->tickets = tickets;
+}
+
+/* Returns the current thread's number of tickets. */
+int
+thread_get_tickets (void) 
+{
+  return thread_current ()->tickets;
+}
+
+/* Returns the current thread's scheduling policy.  A throttled
+   EDF thread reports SCHED_NORMAL until its next period. */
+enum sched_policy
+thread_get_policy (void) 
+{
+  return thread_current ()->policy;
+}
+
+/* Moves the current thread to scheduling POLICY.  For SCHED_EDF,
+   the thread reserves RUNTIME ticks of CPU time in every PERIOD
+   ticks, replacing any reservation it already has.  Returns true
+   if successful.  Returns false, and leaves the thread as it
+   was, if the reservation would overcommit the CPU.  Yields if
+   the change leaves a ready thread that should preempt the
+   current one. */
+bool
+thread_set_policy (enum sched_policy policy, int runtime, int period) 
+{
+  struct thread *cur = thread_current ();
+  int old_runtime = cur->edf_runtime;
+  int old_period = cur->edf_period;
+  enum intr_level old_level;
+  bool success = true;
+
+  ASSERT (policy < SCHED_POLICY_CNT);
+  ASSERT (policy != SCHED_EDF || (0 < runtime && runtime <= period));
+
+  old_level = intr_disable ();
+  if (old_period != 0)
+    sched_edf_detach (cur);
+  if (policy == SCHED_EDF && !sched_edf_reserve (runtime, period)) 
+    {
+      /* Put back the old reservation, which still fits, or keep
+         the old policy. */
+      success = false;
+      if (old_period != 0) 
+        {
+          runtime = old_runtime;
+          period = old_period;
+          sched_edf_reserve (runtime, period);
+        }
+      else
+        policy = cur->policy;
+    }
+  if (policy == SCHED_EDF)
+    sched_edf_attach (cur, runtime, period);
+  thread_change_policy (cur, policy);
+  intr_set_level (old_level);
+
+  thread_check_preempt ();
+  return success;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+
+  return recent_cpu_100;
+}
+
+/* Does the MLFQS bookkeeping for timer tick, with CUR the
+   running thread.  Runs in an external interrupt context.  The
+   system-wide work is left to the boot CPU, whose ticks are the
+   ones that timer_ticks() counts. */
+static void
+mlfqs_tick (struct thread *cur) 
+{
+  int64_t now = timer_ticks ();
+  bool boot_cpu = cur->cpu == &cpus[0];
+  int i;
+
+  if (!is_idle_thread (cur))
+    cur->recent_cpu = fp_add_int (cur->recent_cpu, 1);
+
+  /* Start a new recomputation pass once per second.  If the
+     previous pass has not finished yet, the new one just
+     continues from where it is with the new decay factor. */
+  if (boot_cpu && now % TIMER_FREQ == 0)
+    {
+      int ready_threads = ready_total ();
+      fixed_t twice_load;
+      unsigned c;
+
+      for (c = 0; c < cpu_cnt; c++)
+        if (cpus[c].running != NULL && !is_idle_thread (cpus[c].running))
+          ready_threads++;
+
+      load_avg = (59 * load_avg + fp_from_int (ready_threads)) / 60;
+      twice_load = 2 * load_avg;
+      mlfqs_decay = fp_div (twice_load, fp_add_int (twice_load, 1));
+      if (mlfqs_cursor == NULL)
+        mlfqs_cursor = list_begin (&all_list);
+      mlfqs_batch = DIV_ROUND_UP (all_cnt, MLFQS_SPREAD_TICKS);
+      if (mlfqs_batch < MLFQS_BATCH_MIN)
+        mlfqs_batch = MLFQS_BATCH_MIN;
+    }
+
+  /* Continue the pass in progress, if any. */
+  for (i = 0; boot_cpu && mlfqs_cursor != NULL && i < mlfqs_batch; i++)
+    {
+      struct thread *t = list_entry (mlfqs_cursor, struct thread, allelem);
+
+      mlfqs_cursor = list_next (mlfqs_cursor);
+      if (mlfqs_cursor == list_end (&all_list))
+        mlfqs_cursor = NULL;
+
+      if (!is_idle_thread (t))
+        {
+          mlfqs_update_recent_cpu (t);
+          change_priority (t, mlfqs_priority (t));
+        }
+    }
+
+  /* Only the running thread's recent_cpu changed since its
+     priority was last computed, so it is the only thread whose
+     priority needs refreshing every fourth tick. */
+  if (now % 4 == 0 && !is_idle_thread (cur))
+    change_priority (cur, mlfqs_priority (cur));
+
+  thread_check_preempt ();
+}
+
+/* Implements thread_tick_deadline() for the MLFQS, which has
+   work to do at the once-per-second load_avg update and for the
+   passes that follow it. */
+static int64_t
+mlfqs_tick_deadline (int64_t now) 
+{
+  if (mlfqs_cursor != NULL)
+    return now + 1;
+  else
+    return (now / TIMER_FREQ + 1) * TIMER_FREQ;
+}
+
+/* Sets up the MLFQS state of new thread T created by PARENT. */
+static void
+mlfqs_fork (struct thread *t, const struct thread *parent) 
+{
+  t->nice = parent->nice;
+  t->recent_cpu = parent->recent_cpu;
+  t->priority = mlfqs_priority (t);
+}
+
+/* Applies one second's worth of decay to T's recent_cpu. */
+static void
+mlfqs_update_recent_cpu (struct thread *t) 
+{
+  t->recent_cpu = fp_add_int (fp_mul (mlfqs_decay, t->recent_cpu), t->nice);
+}
+
+/* Returns T's MLFQS priority, computed from its recent_cpu and
+   niceness and clamped to the valid range. */
+static int
+mlfqs_priority (const struct thread *t) 
+{
+  int priority = PRI_MAX - fp_trunc (t->recent_cpu / 4) - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  else if (priority > PRI_MAX)
+    return PRI_MAX;
+  else
+    return priority;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it becomes its CPU's idle_thread, "up"s the semaphore
+   passed to it to enable thread_start() to continue, and
+   immediately blocks.  After that, the idle thread never appears
+   in the ready list.  It is returned by next_thread_to_run() as
+   a special case when the ready list is empty. */
 static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  thread_current ()->cpu->idle_thread = thread_current ();
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Sets up an idle thread for CPU, an application processor that
+   smp_start() is about to start, as if it were already running
+   there.  Returns the top of the thread's stack, for the AP's
+   startup code, or a null pointer if memory is short. */
+void *
+thread_prepare_ap (struct cpu *cpu) 
+{
+  struct thread *t = alloc_thread_page ();
+  char name[16];
+
+  ASSERT (!cpu->started);
+
+  if (t == NULL)
+    return NULL;
+  snprintf (name, sizeof name, "idle%u", cpu->id);
+  init_thread (t, name, PRI_MIN);
+  t->tid = allocate_tid ();
+  t->status = THREAD_RUNNING;
+  t->cpu = cpu;
+  t->detached = true;
+  cpu->idle_thread = cpu->running = t;
+  return t->stack;
+}
+
+/* Called on an application processor, in the idle thread that
+   thread_prepare_ap() set up for it, once the AP is ready to
+   run threads.  Interrupts must be off and the AP must hold the
+   kernel lock.  Never returns. */
+void
+thread_start_ap (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (is_idle_thread (thread_current ()));
+
+  idle_loop ();
+}
+
+/* Body of each CPU's idle thread. */
+static void
+idle_loop (void) 
+{
   for (;;) 
     {
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
+      /* Nothing else is ready, so zero free pages for later
+         PAL_ZERO requests.  Interrupts are on meanwhile, so a
+         thread that becomes ready preempts us right away.  This
+         holds the kernel lock throughout, so stop as soon as any
+         CPU has work. */
+      intr_enable ();
+      while (thread_cpus_idle () && palloc_zero_idle ())
+        continue;
+      intr_disable ();
+
+      /* Leave the kernel.  The interrupt that wakes us up takes
+         the kernel lock back. */
+      kernel_lock_release ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -425,6 +1091,85 @@ idle (void *idle_started_ UNUSED)
     }
 }
 
+/* Reaper thread.  Cleans up after threads that have died.
+
+   Tearing down a dead process's page directory can take a while,
+   so it is done here rather than on the exiting thread's way
+   out.  Once a dead thread is cleaned up, its page is freed if
+   nobody needs its `struct thread' anymore; otherwise it becomes
+   a zombie, and thread_release() frees it later. */
+static void
+reaper (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      struct thread *t;
+      enum intr_level old_level;
+
+      sema_down (&reap_sema);
+      old_level = intr_disable ();
+      t = list_entry (list_pop_front (&dead_list), struct thread, elem);
+      intr_set_level (old_level);
+
+#ifdef USERPROG
+      process_cleanup (t);
+#endif
+
+      old_level = intr_disable ();
+      if (t->detached)
+        free_thread_page (t);
+      else
+        t->status = THREAD_ZOMBIE;
+      intr_set_level (old_level);
+    }
+}
+
+/* Returns a page for a new thread, or a null pointer if none is
+   available.  Prefers a page from the thread page cache.  The
+   page is not zeroed: init_thread() clears `struct thread', and
+   the rest of the page is stack. */
+static void *
+alloc_thread_page (void) 
+{
+  void *page;
+
+  spinlock_acquire (&thread_cache_lock);
+  page = thread_cache;
+  if (page != NULL)
+    {
+      thread_cache = *(void **) page;
+      thread_cache_cnt--;
+    }
+  spinlock_release (&thread_cache_lock);
+
+  return page != NULL ? page : palloc_get_page (0);
+}
+
+/* Frees T's page, or keeps it in the thread page cache if there
+   is room.  Interrupts must be off. */
+static void
+free_thread_page (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t != initial_thread);
+
+  /* Make stale pointers to T fail is_thread(). */
+  t->magic = 0;
+
+  spinlock_acquire (&thread_cache_lock);
+  if (thread_cache_cnt < THREAD_CACHE_SIZE)
+    {
+      *(void **) t = thread_cache;
+      thread_cache = t;
+      thread_cache_cnt++;
+      t = NULL;
+    }
+  spinlock_release (&thread_cache_lock);
+
+  if (t != NULL)
+    palloc_free_page (t);
+}
+
 /* Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux) 
@@ -450,6 +1195,17 @@ running_thread (void)
   return pg_round_down (esp);
 }
 
+/* Returns the CPU that is running the caller.  Until
+   thread_init() has made the boot CPU's code a thread, only the
+   boot CPU runs, so that is the answer. */
+struct cpu *
+cpu_current (void) 
+{
+  struct thread *t = running_thread ();
+
+  return is_thread (t) && t->cpu != NULL ? t->cpu : &cpus[0];
+}
+
 /* Returns true if T appears to point to a valid thread. */
 static bool
 is_thread (struct thread *t)
@@ -457,6 +1213,98 @@ is_thread (struct thread *t)
   return t != NULL && t->magic == THREAD_MAGIC;
 }
 
+/* Returns true if T is the idle thread of the CPU that last ran
+   it. */
+static bool
+is_idle_thread (const struct thread *t) 
+{
+  return t->cpu != NULL && t == t->cpu->idle_thread;
+}
+
+/* Returns true if CPU is running its idle thread and has no
+   ready threads. */
+static bool
+cpu_idle (const struct cpu *cpu) 
+{
+  return (cpu->running != NULL && is_idle_thread (cpu->running)
+          && ready_cnt[cpu->id] == 0);
+}
+
+/* Returns the number of ready threads on all CPUs. */
+static int
+ready_total (void) 
+{
+  int total = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    total += ready_cnt[i];
+  return total;
+}
+
+/* Returns the CPU whose run queue thread T, which is becoming
+   ready, should join: the CPU that last ran T, whose cache may
+   still hold T's working set, unless that CPU is busy and
+   another one is idle.  A new thread starts out on the current
+   CPU on the same terms.  Interrupts must be off. */
+static struct cpu *
+select_cpu (const struct thread *t) 
+{
+  struct cpu *cpu = t->cpu != NULL ? t->cpu : cpu_current ();
+  unsigned i;
+
+  if (cpu_idle (cpu))
+    return cpu;
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].started && cpu_idle (&cpus[i]))
+      return &cpus[i];
+  return cpu;
+}
+
+/* Removes and returns the thread to run next from CPU's run
+   queues, or returns a null pointer if they are empty.
+   Interrupts must be off. */
+static struct thread *
+pick_ready (struct cpu *cpu) 
+{
+  enum sched_policy policy;
+
+  for (policy = 0; policy < SCHED_POLICY_CNT; policy++)
+    if (policy_ready_cnt[cpu->id][policy] > 0) 
+      {
+        struct thread *t = classes[policy]->pick_next (cpu);
+        ASSERT (t != NULL);
+        ASSERT (t->cpu == cpu);
+        policy_ready_cnt[cpu->id][policy]--;
+        ready_cnt[cpu->id]--;
+        return t;
+      }
+  return NULL;
+}
+
+/* Removes and returns a thread from the run queues of the CPU
+   with the most ready threads, for THIEF, whose own queues are
+   empty.  Returns a null pointer if no other CPU has a ready
+   thread.  A thread on another CPU's queue has been switched
+   out completely, because that CPU cannot have let go of the
+   kernel lock since queuing it without doing so.  Interrupts
+   must be off. */
+static struct thread *
+steal_ready (struct cpu *thief) 
+{
+  struct cpu *victim = NULL;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      struct cpu *cpu = &cpus[i];
+      if (cpu != thief && cpu->started && ready_cnt[i] > 0
+          && (victim == NULL || ready_cnt[i] > ready_cnt[victim->id]))
+        victim = cpu;
+    }
+  return victim != NULL ? pick_ready (victim) : NULL;
+}
+
 /* Does basic initialization of T as a blocked thread named
    NAME. */
 static void
@@ -472,23 +1320,40 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  t->tickets = TICKETS_DEFAULT;
+  t->policy = SCHED_NORMAL;
+  list_init (&t->held_locks);
+  t->state_tsc = rdtsc ();
   t->magic = THREAD_MAGIC;
 
-  #ifdef USERPROG
-  list_init(&t->children);
-  int i;
-  for (i = 0; i < 128; i++)
-  {
-    t->fd_table[i] = NULL;
-  }
-  #endif
-
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
+  all_cnt++;
   intr_set_level (old_level);
 }
 
+/* Changes T's priority to PRIORITY, moving T to the matching
+   run queue if it is ready.  Interrupts must be off. */
+static void
+change_priority (struct thread *t, int priority) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (t->priority == priority)
+    return;
+
+  if (t->status == THREAD_READY)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
    returns a pointer to the frame's base. */
 static void *
@@ -502,22 +1367,131 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Chooses and returns the next thread to be scheduled on CPU.
+   Should return a thread from CPU's run queue, unless the run
+   queue is empty.  (If the running thread can continue running,
+   then it will be in the run queue.)  If the run queue is empty,
+   steals a thread from another CPU's, and if there is none
+   there either, returns CPU's idle thread. */
 static struct thread *
-next_thread_to_run (void) 
+next_thread_to_run (struct cpu *cpu) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  struct thread *t = pick_ready (cpu);
+
+  if (t == NULL)
+    t = steal_ready (cpu);
+  return t != NULL ? t : cpu->idle_thread;
+}
+
+/* Adds T to the run queue for its policy on T's CPU, and
+   interrupts that CPU if it is another one and T should preempt
+   the thread running there.  Interrupts must be off. */
+static void
+ready_push (struct thread *t) 
+{
+  struct cpu *cpu = t->cpu;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  classes[t->policy]->enqueue (t);
+  policy_ready_cnt[cpu->id][t->policy]++;
+  ready_cnt[cpu->id]++;
+
+  if (cpu != cpu_current () && should_preempt (cpu->running))
+    smp_send_resched (cpu);
+}
+
+/* Removes ready thread T from the run queue.  Interrupts must be
+   off. */
+static void
+ready_remove (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  classes[t->policy]->dequeue (t);
+  policy_ready_cnt[t->cpu->id][t->policy]--;
+  ready_cnt[t->cpu->id]--;
+}
+
+/* Changes T's scheduling policy to POLICY, moving T to the
+   matching run queue if it is ready.  Interrupts must be off. */
+void
+thread_change_policy (struct thread *t, enum sched_policy policy) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (policy < SCHED_POLICY_CNT);
+
+  if (t->policy == policy)
+    return;
+
+  if (t->status == THREAD_READY)
+    {
+      ready_remove (t);
+      t->policy = policy;
+      ready_push (t);
+    }
+  else
+    t->policy = policy;
+}
+
+/* Returns the index of the most significant set bit in MASK,
+   which must be nonzero.  Splitting MASK into halves lets GCC
+   emit a single BSR per half instead of a libgcc call. */
+static inline int
+highest_bit (uint64_t mask) 
+{
+  uint32_t high = mask >> 32;
+
+  ASSERT (mask != 0);
+  if (high != 0)
+    return 63 - __builtin_clz (high);
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return 31 - __builtin_clz ((uint32_t) mask);
+}
+
+/* Charges the time since T last changed state, up to NOW, to
+   the statistic for T's current state.  A thread that was just
+   woken up is counted in the wakeup latency histogram when it
+   leaves the run queue.  Interrupts must be off. */
+static void
+account_state (struct thread *t, uint64_t now) 
+{
+  uint64_t delta = now - t->state_tsc;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  switch (t->status) 
+    {
+    case THREAD_RUNNING:
+      t->run_tsc += delta;
+      break;
+
+    case THREAD_READY:
+      t->ready_tsc += delta;
+      if (t->woken) 
+        {
+          int bucket = delta < 2 ? 0 : highest_bit (delta);
+          if (bucket >= LATENCY_BUCKETS)
+            bucket = LATENCY_BUCKETS - 1;
+          latency_hist[bucket]++;
+          t->woken = false;
+        }
+      break;
+
+    case THREAD_BLOCKED:
+      t->blocked_tsc += delta;
+      break;
+
+    default:
+      break;
+    }
+  t->state_tsc = now;
 }
 
 /* Completes a thread switch by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+   tables, and, if the previous thread is dying, handing it to
+   the reaper.
 
    At this function's invocation, we just switched from thread
    PREV, the new thread is already running, and interrupts are
@@ -543,22 +1517,24 @@ thread_schedule_tail (struct thread *prev)
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cur->cpu->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
 #endif
 
-  /* If the thread we switched from is dying, destroy its struct
-     thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
-     initial_thread because its memory was not obtained via
-     palloc().) */
+  /* If the thread we switched from is dying, hand it to the
+     reaper, which will destroy its struct thread.  This must
+     happen late so that thread_exit() doesn't pull out the rug
+     under itself.  (We don't free initial_thread because its
+     memory was not obtained via palloc().)  Interrupts are off,
+     so "up"ing reap_sema cannot switch threads here. */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      //palloc_free_page (prev);
+      list_push_back (&dead_list, &prev->elem);
+      sema_up (&reap_sema);
     }
 }
 
@@ -573,15 +1549,33 @@ static void
 schedule (void) 
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct cpu *cpu = cur->cpu;
+  struct thread *next = next_thread_to_run (cpu);
   struct thread *prev = NULL;
+  uint64_t now = rdtsc ();
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  /* CUR has been running since it last changed state, whatever
+     its new state is.  NEXT is leaving the run queue, or, if it
+     is the idle thread, its blocked state. */
+  cur->run_tsc += now - cur->state_tsc;
+  cur->state_tsc = now;
+  account_state (next, now);
+
+  /* The timer may have stopped ticking while the CPU was idle. */
+  if (cur == cpu->idle_thread && next != cpu->idle_thread)
+    timer_idle_exit ();
+
+  next->cpu = cpu;
+  cpu->running = next;
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      cpu->switches++;
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -592,13 +1586,237 @@ allocate_tid (void)
   static tid_t next_tid = 1;
   tid_t tid;
 
-  lock_acquire (&tid_lock);
+  spinlock_acquire (&tid_lock);
   tid = next_tid++;
-  lock_release (&tid_lock);
+  spinlock_release (&tid_lock);
 
   return tid;
 }
 
+/* Selects the scheduling class for SCHED_NORMAL threads, which
+   is named NAME, one of "rr", "priority", "mlfqs", or "stride".
+   Returns true if successful, false if there is no such class.
+   Must be called before thread_init(). */
+bool
+thread_set_sched (const char *name) 
+{
+  static const struct sched_class *normal_classes[] =
+    {&sched_rr, &sched_priority, &sched_mlfqs, &sched_stride};
+  size_t i;
+
+  for (i = 0; i < sizeof normal_classes / sizeof *normal_classes; i++)
+    if (!strcmp (name, normal_classes[i]->name)) 
+      {
+        classes[SCHED_NORMAL] = normal_classes[i];
+        thread_mlfqs = normal_classes[i] == &sched_mlfqs;
+        return true;
+      }
+  return false;
+}
+
+/* Round-robin scheduling: one FIFO run queue, ignoring
+   priorities. */
+
+static void
+rr_init (void) 
+{
+  int i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    list_init (&rr_queue[i]);
+}
+
+static void
+rr_enqueue (struct thread *t) 
+{
+  list_push_back (&rr_queue[t->cpu->id], &t->elem);
+}
+
+static void
+rr_dequeue (struct thread *t) 
+{
+  list_remove (&t->elem);
+}
+
+static struct thread *
+rr_pick_next (struct cpu *cpu) 
+{
+  struct list *queue = &rr_queue[cpu->id];
+
+  if (list_empty (queue))
+    return NULL;
+  return list_entry (list_pop_front (queue), struct thread, elem);
+}
+
+/* Threads only give up the CPU at the end of a time slice. */
+static bool
+rr_preempt (const struct thread *cur UNUSED) 
+{
+  return false;
+}
+
+const struct sched_class sched_rr =
+  {
+    "rr",
+    rr_init,
+    rr_enqueue,
+    rr_dequeue,
+    rr_pick_next,
+    rr_preempt,
+    NULL,
+    NULL,
+    NULL
+  };
+
+/* Idle scheduling: one FIFO run queue for SCHED_IDLE threads,
+   which run only when no other thread is ready. */
+
+static void
+idle_init (void) 
+{
+  int i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    list_init (&idle_queue[i]);
+}
+
+static void
+idle_enqueue (struct thread *t) 
+{
+  list_push_back (&idle_queue[t->cpu->id], &t->elem);
+}
+
+static void
+idle_dequeue (struct thread *t) 
+{
+  list_remove (&t->elem);
+}
+
+static struct thread *
+idle_pick_next (struct cpu *cpu) 
+{
+  struct list *queue = &idle_queue[cpu->id];
+
+  if (list_empty (queue))
+    return NULL;
+  return list_entry (list_pop_front (queue), struct thread, elem);
+}
+
+static bool
+idle_preempt (const struct thread *cur UNUSED) 
+{
+  return false;
+}
+
+const struct sched_class sched_idle =
+  {
+    "idle",
+    idle_init,
+    idle_enqueue,
+    idle_dequeue,
+    idle_pick_next,
+    idle_preempt,
+    NULL,
+    NULL,
+    NULL
+  };
+
+/* Priority scheduling, the default, and the MLFQS, which share
+   the ready_queues run queue and differ only in how they set
+   priorities. */
+
+static void
+prio_init (void) 
+{
+  int cpu, i;
+
+  for (cpu = 0; cpu < CPU_MAX; cpu++) 
+    {
+      for (i = 0; i <= PRI_MAX; i++)
+        list_init (&ready_queues[cpu][i]);
+      ready_mask[cpu] = 0;
+    }
+}
+
+/* Adds T to the back of the run queue for its priority. */
+static void
+prio_enqueue (struct thread *t) 
+{
+  unsigned id = t->cpu->id;
+
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_queues[id][t->priority], &t->elem);
+  ready_mask[id] |= (uint64_t) 1 << t->priority;
+}
+
+static void
+prio_dequeue (struct thread *t) 
+{
+  unsigned id = t->cpu->id;
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[id][t->priority]))
+    ready_mask[id] &= ~((uint64_t) 1 << t->priority);
+}
+
+/* Removes and returns the first thread in CPU's highest-priority
+   nonempty run queue. */
+static struct thread *
+prio_pick_next (struct cpu *cpu) 
+{
+  uint64_t *mask = &ready_mask[cpu->id];
+  int priority;
+  struct list *queue;
+  struct thread *t;
+
+  if (*mask == 0)
+    return NULL;
+
+  priority = highest_bit (*mask);
+  queue = &ready_queues[cpu->id][priority];
+  t = list_entry (list_pop_front (queue), struct thread, elem);
+  if (list_empty (queue))
+    *mask &= ~((uint64_t) 1 << priority);
+  return t;
+}
+
+/* Returns true if some thread ready on CUR's CPU has a higher
+   priority than CUR. */
+static bool
+prio_preempt (const struct thread *cur) 
+{
+  uint64_t mask = ready_mask[cur->cpu->id];
+
+  return mask != 0 && highest_bit (mask) > cur->priority;
+}
+
+const struct sched_class sched_priority =
+  {
+    "priority",
+    prio_init,
+    prio_enqueue,
+    prio_dequeue,
+    prio_pick_next,
+    prio_preempt,
+    NULL,
+    NULL,
+    NULL
+  };
+
+const struct sched_class sched_mlfqs =
+  {
+    "mlfqs",
+    prio_init,
+    prio_enqueue,
+    prio_dequeue,
+    prio_pick_next,
+    prio_preempt,
+    mlfqs_tick,
+    mlfqs_fork,
+    mlfqs_tick_deadline
+  };
+
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
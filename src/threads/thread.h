@@ -4,7 +4,10 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
+#include "devices/timer.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -12,7 +15,19 @@ enum thread_status
     THREAD_RUNNING,     /* Running thread. */
     THREAD_READY,       /* Not running but ready to run. */
     THREAD_BLOCKED,     /* Waiting for an event to trigger. */
-    THREAD_DYING        /* About to be destroyed. */
+    THREAD_DYING,       /* About to be destroyed. */
+    THREAD_ZOMBIE       /* Destroyed, but not yet released. */
+  };
+
+/* Scheduling policies, in decreasing order of precedence.  A
+   thread runs only when no thread with a policy of higher
+   precedence is ready. */
+enum sched_policy
+  {
+    SCHED_EDF,          /* Real time, earliest deadline first. */
+    SCHED_NORMAL,       /* The scheduler chosen with "-sched". */
+    SCHED_IDLE,         /* Runs only when nothing else is ready. */
+    SCHED_POLICY_CNT    /* Number of policies. */
   };
 
 /* Thread identifier type.
@@ -25,7 +40,16 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
-#define FD_TABLE_SIZE 128
+/* Thread niceness, for the MLFQS. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice to other threads. */
+
+/* Thread tickets, for stride scheduling. */
+#define TICKETS_MIN 1                   /* Smallest CPU share. */
+#define TICKETS_DEFAULT 100             /* Default CPU share. */
+#define TICKETS_MAX 10000               /* Largest CPU share. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -78,55 +102,102 @@ typedef int tid_t;
    value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   semaphore wait list (synch.c) or the sleep list
+   (devices/timer.c).  It can be used these ways only because
+   they are mutually exclusive: only a thread in the ready state
+   is on the run queue, whereas only a thread in the blocked
+   state is on a semaphore wait list or the sleep list, and a
+   blocked thread waits for only one thing at a time. */
 struct thread
   {
     /* Owned by thread.c. */
     tid_t tid;                          /* Thread identifier. */
     enum thread_status status;          /* Thread state. */
+    struct cpu *cpu;                    /* CPU running it or that last did. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donations. */
+    int nice;                           /* Niceness, for the MLFQS. */
+    fixed_t recent_cpu;                 /* Recent CPU time, for the MLFQS. */
+    int tickets;                        /* Tickets, for stride scheduling. */
+    int64_t pass;                       /* Virtual time, for stride. */
+    enum sched_policy policy;           /* Class whose run queue to use. */
     struct list_elem allelem;           /* List element for all threads list. */
+    bool detached;                      /* Free page as soon as it dies? */
 
-    /* Shared between thread.c and synch.c. */
+    /* Scheduling statistics, in TSC cycles, updated at each
+       change of state.  See thread_print_stats(). */
+    uint64_t run_tsc;                   /* Time spent running. */
+    uint64_t ready_tsc;                 /* Time spent in the run queue. */
+    uint64_t blocked_tsc;               /* Time spent blocked. */
+    uint64_t state_tsc;                 /* TSC at last change of state. */
+    bool woken;                         /* Made ready by thread_unblock()? */
+
+    /* Shared between thread.c, synch.c, and devices/timer.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Shared between thread.c and synch.c. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for, if any. */
+
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_time;                /* PIT cycle to wake up at. */
+
+    /* Owned by threads/sched-edf.c.  A thread with a nonzero
+       period has an EDF reservation, even while it is throttled
+       and runs under SCHED_NORMAL. */
+    int edf_runtime;                    /* Ticks reserved per period. */
+    int edf_period;                     /* Period in ticks, or 0. */
+    int edf_budget;                     /* Ticks left in this period. */
+    int64_t edf_deadline;               /* Tick at which period ends. */
+    struct timer edf_timer;             /* Ends throttling. */
+
+    /* Owned by threads/malloc.c. */
+    struct magazines mags;              /* Cached free blocks. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
-    uint32_t *pagedir;                  /* Page directory. */
+    struct process *process;            /* Process, or null if kernel. */
+    struct uthread *uthread;            /* Null in a process's main thread. */
     struct thread *parent;
-    struct list children;
-    struct list_elem child_elem;
+    struct list_elem child_elem;          /* Element in process's children. */
     struct semaphore exec_sema;
     struct semaphore wait_sema;
     int load_status;                      /* 0 : Not loaded yet. / 1 : Load succeeded. / -1 : Load failed. */
     int exit_status;
     bool wait_status;                     /* true : This thread is already waited by parent / false : Not being waited. */
     bool is_terminated;
-    struct file *fd_table[FD_TABLE_SIZE];
 #endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
 
-/* If false (default), use round-robin scheduler.
-   If true, use multi-level feedback queue scheduler.
-   Controlled by kernel command-line option "-o mlfqs". */
+/* True if the multi-level feedback queue scheduler is in use.
+   Controlled by kernel command-line options "-sched=mlfqs" and
+   "-mlfqs". */
 extern bool thread_mlfqs;
 
+bool thread_set_sched (const char *name);
 void thread_init (void);
 void thread_start (void);
+void *thread_prepare_ap (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
+void thread_tick_idle (void);
+int64_t thread_tick_deadline (int64_t now);
+bool thread_cpus_idle (void);
 void thread_print_stats (void);
+int64_t thread_get_idle_ticks (void);
+long long thread_get_switch_cnt (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_edf (const char *name, int runtime, int period,
+                         thread_func *, void *);
+tid_t thread_create_idle (const char *name, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
@@ -136,7 +207,9 @@ tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
+void thread_release (struct thread *);
 void thread_yield (void);
+void thread_check_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -144,10 +217,16 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
+int thread_get_tickets (void);
+void thread_set_tickets (int);
+
+enum sched_policy thread_get_policy (void);
+bool thread_set_policy (enum sched_policy, int runtime, int period);
 int thread_get_load_avg (void);
 
 #endif /* threads/thread.h */
@@ -0,0 +1,183 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous kernel allocations.
+
+   Everything else in the kernel lives in the mapping of physical
+   memory that starts at PHYS_BASE, so a block of N pages needs N
+   physically contiguous free pages.  Once memory is fragmented,
+   big requests fail even though plenty of pages are free.
+   vmalloc() instead takes pages one at a time from the page
+   allocator and maps them at consecutive addresses in a region
+   of kernel virtual memory set aside above the physical memory
+   mapping.
+
+   The page tables for the whole region are created at boot and
+   never freed.  Every process's page directory is a copy of
+   init_page_dir, so it shares them, and a mapping added later
+   shows up in all address spaces at once.
+
+   Each allocation is followed by an unmapped guard page, which
+   catches overruns and also marks where the allocation ends, so
+   vfree() needs no record of its size.  Unmapping pages flushes
+   them from the local TLB and then shoots down the other CPUs'
+   TLBs.  The other CPUs cannot run kernel code, which is all
+   that may touch the region, until they have taken the kernel
+   lock, and they flush their TLBs before that, so the pages may
+   be freed before the shootdown finishes.
+
+   Memory from vmalloc() is not physically contiguous, so vtop()
+   must not be used on it. */
+
+/* Bounds of the region. */
+#define VMALLOC_START ((uint8_t *) PHYS_BASE + 0x30000000)
+#define VMALLOC_SIZE (16 * 1024 * 1024)
+#define VMALLOC_PAGES (VMALLOC_SIZE / PGSIZE)
+
+/* Pages of the region in use, counting guard pages. */
+static struct bitmap *used_map;
+static struct lock vmalloc_lock;
+
+static uint32_t *lookup_pte (const void *vaddr);
+static void unmap (uint8_t *vaddr, size_t page_cnt);
+
+/* Sets up the vmalloc() region in init_page_dir.  Must be
+   called after malloc_init() and paging_init(), and before any
+   other page directory is created. */
+void
+vmalloc_init (void) 
+{
+  uint8_t *vaddr;
+
+  ASSERT (init_page_dir != NULL);
+  ASSERT ((uint8_t *) ptov (init_ram_pages * PGSIZE) <= VMALLOC_START);
+  ASSERT ((uintptr_t) VMALLOC_START % PTSPAN == 0);
+
+  for (vaddr = VMALLOC_START; vaddr < VMALLOC_START + VMALLOC_SIZE;
+       vaddr += PTSPAN)
+    {
+      uint32_t *pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      init_page_dir[pd_no (vaddr)] = pde_create (pt);
+    }
+
+  used_map = bitmap_create (VMALLOC_PAGES);
+  if (used_map == NULL)
+    PANIC ("vmalloc_init: out of memory");
+  lock_init (&vmalloc_lock, "vmalloc");
+}
+
+/* Obtains and returns SIZE bytes of virtually contiguous kernel
+   memory, rounded up to whole pages.  Returns a null pointer if
+   SIZE is 0 or if the region or the kernel pool has too little
+   memory left. */
+void *
+vmalloc (size_t size) 
+{
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  size_t page_idx;
+  uint8_t *start;
+  size_t i;
+
+  if (page_cnt == 0 || page_cnt >= VMALLOC_PAGES)
+    return NULL;
+
+  /* Reserve the pages and a guard page after them. */
+  lock_acquire (&vmalloc_lock);
+  page_idx = bitmap_scan_and_flip (used_map, 0, page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+  if (page_idx == BITMAP_ERROR)
+    return NULL;
+  start = VMALLOC_START + page_idx * PGSIZE;
+
+  /* Map a page at each address. */
+  for (i = 0; i < page_cnt; i++) 
+    {
+      void *page = palloc_get_page (0);
+      if (page == NULL) 
+        {
+          unmap (start, i);
+          lock_acquire (&vmalloc_lock);
+          bitmap_set_multiple (used_map, page_idx, page_cnt + 1, false);
+          lock_release (&vmalloc_lock);
+          return NULL;
+        }
+      *lookup_pte (start + i * PGSIZE) = pte_create_kernel (page, true);
+    }
+
+  return start;
+}
+
+/* Frees BLOCK, which must have been returned by vmalloc(). */
+void
+vfree (void *block) 
+{
+  uint8_t *start = block;
+  size_t page_cnt;
+
+  if (block == NULL)
+    return;
+  ASSERT (is_vmalloc_vaddr (block));
+  ASSERT (pg_ofs (block) == 0);
+
+  /* The allocation runs up to its guard page. */
+  for (page_cnt = 0; *lookup_pte (start + page_cnt * PGSIZE) & PTE_P;
+       page_cnt++)
+    continue;
+  ASSERT (page_cnt > 0);
+  unmap (start, page_cnt);
+
+  lock_acquire (&vmalloc_lock);
+  ASSERT (bitmap_all (used_map, (start - VMALLOC_START) / PGSIZE,
+                      page_cnt + 1));
+  bitmap_set_multiple (used_map, (start - VMALLOC_START) / PGSIZE,
+                       page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+}
+
+/* Returns true if VADDR is in the vmalloc() region. */
+bool
+is_vmalloc_vaddr (const void *vaddr) 
+{
+  return ((const uint8_t *) vaddr >= VMALLOC_START
+          && (const uint8_t *) vaddr < VMALLOC_START + VMALLOC_SIZE);
+}
+
+/* Returns the page table entry for VADDR, which must be in the
+   vmalloc() region. */
+static uint32_t *
+lookup_pte (const void *vaddr) 
+{
+  ASSERT (is_vmalloc_vaddr (vaddr));
+  return pde_get_pt (init_page_dir[pd_no (vaddr)]) + pt_no (vaddr);
+}
+
+/* Unmaps the PAGE_CNT pages starting at VADDR and frees the
+   pages they were mapped to. */
+static void
+unmap (uint8_t *vaddr, size_t page_cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++, vaddr += PGSIZE) 
+    {
+      uint32_t *pte = lookup_pte (vaddr);
+      void *page = pte_get_page (*pte);
+
+      ASSERT (*pte & PTE_P);
+      *pte = 0;
+      asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+      palloc_free_page (page);
+    }
+  smp_tlb_shootdown (NULL);
+}
@@ -0,0 +1,448 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Workqueues, for work deferred out of interrupt handlers and
+   other critical paths into kernel threads.
+
+   A workqueue has a fixed pool of worker threads, created along
+   with it, and a queue of pending work items in decreasing order
+   of priority, FIFO among equal priorities.  Each worker
+   repeatedly takes the first item off the queue and calls its
+   function.  Items may be queued from interrupt handlers, so the
+   queue is protected by disabling interrupts, and a semaphore
+   counts the items for the workers to wait on.  Delayed work is
+   added to the queue by a timer callback.
+
+   Nothing touches a work item after its function starts, so the
+   function may free the item or queue it again.  To tell whether
+   an item is running, work_flush() looks at the item that each
+   worker is running instead. */
+
+/* Number of worker threads in system_wq. */
+#define SYSTEM_WQ_WORKERS 2
+
+/* A worker thread. */
+struct worker
+  {
+    struct workqueue *wq;       /* Owning workqueue. */
+    struct work *current;       /* Item being run, or null. */
+  };
+
+/* A workqueue. */
+struct workqueue
+  {
+    struct list_elem elem;      /* Element in all_wqs. */
+    const char *name;           /* Name, for statistics. */
+    struct list queue;          /* Pending items, by priority. */
+    struct semaphore ready;     /* Up once per item queued. */
+    struct list flushers;       /* Threads waiting for items to run. */
+    struct worker *workers;     /* Worker threads. */
+    int worker_cnt;             /* Number of workers. */
+    int running_cnt;            /* Number of workers running items. */
+
+    /* Statistics. */
+    int depth;                  /* Items in QUEUE. */
+    int max_depth;              /* Greatest DEPTH. */
+    long long run_cnt;          /* Items run. */
+    int64_t latency_ns;         /* Total time from queued to start. */
+    int64_t max_latency_ns;     /* Longest time from queued to start. */
+    int64_t run_ns;             /* Total time in work functions. */
+    int64_t max_run_ns;         /* Longest time in a work function. */
+  };
+
+/* A thread waiting in work_flush() or workqueue_flush(). */
+struct flusher
+  {
+    struct list_elem elem;      /* Element in workqueue's flushers. */
+    struct semaphore sema;      /* Up when an item finishes. */
+  };
+
+/* All workqueues. */
+static struct list all_wqs = LIST_INITIALIZER (all_wqs);
+
+struct workqueue *system_wq;
+
+static thread_func worker_loop;
+static timer_func work_timer_expired;
+static void enqueue (struct workqueue *, struct work *);
+static bool is_running (struct workqueue *, const struct work *);
+static void wait_for_finish (struct workqueue *);
+static void wake_flushers (struct workqueue *);
+
+/* Creates system_wq.  Must be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  system_wq = workqueue_create ("system-wq", SYSTEM_WQ_WORKERS,
+                                PRI_DEFAULT);
+  if (system_wq == NULL)
+    PANIC ("couldn't create system workqueue");
+}
+
+/* Creates and returns a workqueue named NAME with WORKER_CNT
+   worker threads, which run at the given PRIORITY.  Returns a
+   null pointer if memory or threads cannot be allocated.  If
+   only some of the workers can be created, the workqueue has
+   fewer workers than asked for.
+
+   Workqueues cannot be destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int worker_cnt, int priority)
+{
+  struct workqueue *wq;
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (name != NULL);
+  ASSERT (worker_cnt > 0);
+
+  wq = malloc (sizeof *wq);
+  if (wq == NULL)
+    return NULL;
+  wq->workers = calloc (worker_cnt, sizeof *wq->workers);
+  if (wq->workers == NULL)
+    {
+      free (wq);
+      return NULL;
+    }
+  wq->name = name;
+  list_init (&wq->queue);
+  sema_init (&wq->ready, 0);
+  list_init (&wq->flushers);
+  wq->running_cnt = 0;
+  wq->depth = wq->max_depth = 0;
+  wq->run_cnt = 0;
+  wq->latency_ns = wq->max_latency_ns = 0;
+  wq->run_ns = wq->max_run_ns = 0;
+
+  for (i = 0; i < worker_cnt; i++)
+    {
+      wq->workers[i].wq = wq;
+      wq->workers[i].current = NULL;
+      if (thread_create (name, priority, worker_loop, &wq->workers[i])
+          == TID_ERROR)
+        break;
+    }
+  if (i == 0)
+    {
+      free (wq->workers);
+      free (wq);
+      return NULL;
+    }
+  wq->worker_cnt = i;
+
+  old_level = intr_disable ();
+  list_push_back (&all_wqs, &wq->elem);
+  intr_set_level (old_level);
+
+  return wq;
+}
+
+/* Waits until WQ has no items queued or running.  Delayed items
+   whose delay has not yet run out are not waited for.  Must not
+   be called by a work function running in WQ. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+
+  old_level = intr_disable ();
+  while (!list_empty (&wq->queue) || wq->running_cnt > 0)
+    wait_for_finish (wq);
+  intr_set_level (old_level);
+}
+
+/* Prints statistics for each workqueue. */
+void
+workqueue_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_wqs); e != list_end (&all_wqs);
+       e = list_next (e))
+    {
+      struct workqueue *wq = list_entry (e, struct workqueue, elem);
+      long long runs = wq->run_cnt > 0 ? wq->run_cnt : 1;
+
+      printf ("Workqueue %s: %d workers, %lld items run, "
+              "max depth %d\n", wq->name, wq->worker_cnt,
+              wq->run_cnt, wq->max_depth);
+      printf ("Workqueue %s: latency %"PRId64" avg, %"PRId64" max ns; "
+              "run time %"PRId64" avg, %"PRId64" max ns\n",
+              wq->name, wq->latency_ns / runs, wq->max_latency_ns,
+              wq->run_ns / runs, wq->max_run_ns);
+    }
+}
+
+/* Initializes work item W to call FUNC(AUX) with the given
+   PRIORITY.  Items with higher priorities run first. */
+void
+work_init (struct work *w, work_func *func, void *aux, int priority)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->priority = priority;
+  w->wq = NULL;
+  w->pending = false;
+  w->queued = false;
+  timer_setup (&w->timer, work_timer_expired, w);
+}
+
+/* Adds W to WQ's queue.  Returns true if successful, false if W
+   was already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool queued;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  queued = !w->pending;
+  if (queued)
+    {
+      w->pending = true;
+      w->wq = wq;
+      enqueue (wq, w);
+    }
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Adds W to WQ's queue once TICKS timer ticks have passed.
+   Returns true if successful, false if W was already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue_delayed (struct workqueue *wq, struct work *w, int64_t ticks)
+{
+  enum intr_level old_level;
+  bool queued;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  if (ticks <= 0)
+    return work_queue (wq, w);
+
+  old_level = intr_disable ();
+  queued = !w->pending;
+  if (queued)
+    {
+      w->pending = true;
+      w->wq = wq;
+      timer_add (&w->timer, timer_ticks () + ticks);
+    }
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Keeps pending item W from running.  Returns true if W was
+   pending, false otherwise.  W's function may still be running
+   when this function returns; call work_flush() afterward to
+   wait for it.
+
+   This function may be called from an interrupt handler. */
+bool
+work_cancel (struct work *w)
+{
+  enum intr_level old_level;
+  bool canceled;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  canceled = w->pending;
+  if (canceled)
+    {
+      w->pending = false;
+
+      /* If W's delay just ran out, its timer is no longer
+         pending but the timer callback may not have queued it
+         yet, so W may be in neither place.  The callback will
+         see that W is not pending and leave it alone. */
+      timer_cancel (&w->timer);
+      if (w->queued)
+        {
+          w->queued = false;
+          list_remove (&w->elem);
+          w->wq->depth--;
+          wake_flushers (w->wq);
+        }
+    }
+  intr_set_level (old_level);
+
+  return canceled;
+}
+
+/* Waits until W is neither pending nor running.  Must not be
+   called by a work function running in W's workqueue. */
+void
+work_flush (struct work *w)
+{
+  enum intr_level old_level;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  if (w->wq != NULL)
+    while (w->pending || is_running (w->wq, w))
+      wait_for_finish (w->wq);
+  intr_set_level (old_level);
+}
+
+/* Worker thread.  Runs the items queued in WORKER_'s
+   workqueue, one at a time, forever. */
+static void
+worker_loop (void *worker_)
+{
+  struct worker *worker = worker_;
+  struct workqueue *wq = worker->wq;
+
+  for (;;)
+    {
+      struct work *w;
+      work_func *func;
+      void *aux;
+      int64_t start, elapsed;
+
+      sema_down (&wq->ready);
+
+      /* The semaphore counts canceled items too, so the queue
+         may be empty. */
+      intr_disable ();
+      if (list_empty (&wq->queue))
+        {
+          intr_enable ();
+          continue;
+        }
+      w = list_entry (list_pop_front (&wq->queue), struct work, elem);
+      w->pending = false;
+      w->queued = false;
+      func = w->func;
+      aux = w->aux;
+      worker->current = w;
+      wq->depth--;
+      wq->running_cnt++;
+      start = timer_now_ns ();
+      elapsed = start - w->queued_ns;
+      wq->latency_ns += elapsed;
+      if (elapsed > wq->max_latency_ns)
+        wq->max_latency_ns = elapsed;
+      intr_enable ();
+
+      func (aux);
+
+      intr_disable ();
+      elapsed = timer_now_ns () - start;
+      wq->run_ns += elapsed;
+      if (elapsed > wq->max_run_ns)
+        wq->max_run_ns = elapsed;
+      wq->run_cnt++;
+      wq->running_cnt--;
+      worker->current = NULL;
+      wake_flushers (wq);
+      intr_enable ();
+    }
+}
+
+/* Timer callback that adds delayed work item W_ to its
+   workqueue's queue. */
+static void
+work_timer_expired (void *w_)
+{
+  struct work *w = w_;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (w->pending)
+    enqueue (w->wq, w);
+  intr_set_level (old_level);
+}
+
+/* Returns true if work item A has a higher priority than B. */
+static bool
+work_higher (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct work *a = list_entry (a_, struct work, elem);
+  const struct work *b = list_entry (b_, struct work, elem);
+
+  return a->priority > b->priority;
+}
+
+/* Adds pending item W to WQ's queue and wakes a worker.
+   Interrupts must be off. */
+static void
+enqueue (struct workqueue *wq, struct work *w)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  w->queued = true;
+  w->queued_ns = timer_now_ns ();
+  list_insert_ordered (&wq->queue, &w->elem, work_higher, NULL);
+  if (++wq->depth > wq->max_depth)
+    wq->max_depth = wq->depth;
+  sema_up (&wq->ready);
+}
+
+/* Returns true if one of WQ's workers is running W.  Interrupts
+   must be off. */
+static bool
+is_running (struct workqueue *wq, const struct work *w)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < wq->worker_cnt; i++)
+    if (wq->workers[i].current == w)
+      return true;
+  return false;
+}
+
+/* Waits until one of WQ's items finishes or is canceled.
+   Interrupts must be off. */
+static void
+wait_for_finish (struct workqueue *wq)
+{
+  struct flusher f;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  sema_init (&f.sema, 0);
+  list_push_back (&wq->flushers, &f.elem);
+  sema_down (&f.sema);
+}
+
+/* Wakes every thread waiting in wait_for_finish() on WQ, so that
+   each can check whether what it waits for has happened.
+   Interrupts must be off. */
+static void
+wake_flushers (struct workqueue *wq)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&wq->flushers))
+    {
+      struct list_elem *e = list_pop_front (&wq->flushers);
+      sema_up (&list_entry (e, struct flusher, elem)->sema);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+/* Work function.  Runs in a worker thread, so unlike a timer
+   callback it may sleep. */
+typedef void work_func (void *aux);
+
+/* An item of deferred work: a call to FUNC(AUX), to be made by
+   a worker thread of a workqueue.  Initialize with work_init().
+
+   A work item is "pending" from the time it is queued until a
+   worker takes it off the queue to run it.  A pending item
+   cannot be queued again, but once its function has started it
+   may be queued again, even by the function itself.  The
+   function may also free the item. */
+struct work
+  {
+    struct list_elem elem;      /* Element in workqueue's queue. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Argument for FUNC. */
+    int priority;               /* Higher priorities run first. */
+    struct workqueue *wq;       /* Queue most recently added to. */
+    bool pending;               /* Queued or delayed, not started? */
+    bool queued;                /* In WQ's queue? */
+    int64_t queued_ns;          /* When added to WQ's queue. */
+    struct timer timer;         /* Delays adding it to WQ's queue. */
+  };
+
+/* Workqueue that any code may use for short work items. */
+extern struct workqueue *system_wq;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int worker_cnt,
+                                    int priority);
+void workqueue_flush (struct workqueue *);
+void workqueue_print_stats (void);
+
+void work_init (struct work *, work_func *, void *aux, int priority);
+bool work_queue (struct workqueue *, struct work *);
+bool work_queue_delayed (struct workqueue *, struct work *, int64_t ticks);
+bool work_cancel (struct work *);
+void work_flush (struct work *);
+
+#endif /* threads/workqueue.h */
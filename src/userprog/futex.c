@@ -0,0 +1,240 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Futexes ("fast user-space mutexes"), wait queues keyed by the
+   address of an int in user memory.
+
+   A user-space lock or other primitive keeps its state in an
+   ordinary int that it updates with atomic instructions, and
+   makes a system call only when it has to sleep or to wake a
+   sleeper.  futex_wait() puts the caller to sleep only if the
+   int still holds the value that the caller last saw, checking
+   and enqueuing atomically with respect to futex_wake(), so that
+   a wakeup between the caller's check and its sleep is never
+   lost.
+
+   Wait queues are kept in a hash table keyed by the physical
+   address of the int, not its user virtual address, so that any
+   address spaces mapping the same frame share a queue.  User
+   pages stay resident while mapped, so the physical address of
+   a mapped int does not change.  A queue exists only while it
+   has waiters.
+
+   The caller must check that the address is a mapped, aligned
+   user address before calling these functions.  Another thread
+   of the process may still unmap it before we look, by exiting
+   and freeing its stack, in which case nothing happens. */
+
+/* Wait queue for one futex. */
+struct futex
+  {
+    struct hash_elem elem;      /* Element in futexes. */
+    uintptr_t paddr;            /* Physical address of the int. */
+    struct list waiters;        /* Waiting threads, in FIFO order. */
+  };
+
+/* A thread waiting on a futex. */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in futex's waiters. */
+    struct semaphore sema;      /* Up when woken. */
+    const struct process *process; /* Waiting thread's process. */
+  };
+
+/* Futexes with waiters, keyed by physical address. */
+static struct hash futexes;
+
+/* Protects FUTEXES and the futexes in it. */
+static struct lock futex_lock;
+
+static hash_hash_func futex_hash;
+static hash_less_func futex_less;
+
+/* Initializes the futex table. */
+void
+futex_init (void) 
+{
+  if (!hash_init (&futexes, futex_hash, futex_less, NULL))
+    PANIC ("couldn't allocate futex table");
+  lock_init (&futex_lock, "futex");
+}
+
+/* Returns the kernel virtual address of the int at user address
+   UADDR in the current process, or a null pointer if UADDR is
+   not mapped. */
+static int *
+futex_kaddr (int *uaddr) 
+{
+  return pagedir_get_page (thread_current ()->process->pagedir, uaddr);
+}
+
+/* Returns the futex for the int at kernel address KADDR, or a
+   null pointer if no thread waits on it.  futex_lock must be
+   held. */
+static struct futex *
+futex_lookup (const int *kaddr) 
+{
+  struct futex key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&futex_lock));
+
+  key.paddr = vtop (kaddr);
+  e = hash_find (&futexes, &key.elem);
+  return e != NULL ? hash_entry (e, struct futex, elem) : NULL;
+}
+
+/* If the int at user address UADDR equals VAL, sleeps until
+   futex_wake() wakes us and returns 0.  Otherwise, returns -1
+   without sleeping.  Also returns -1 if memory for the wait
+   queue cannot be allocated. */
+int
+futex_wait (int *uaddr, int val) 
+{
+  struct futex_waiter w;
+  struct futex *f;
+  int *kaddr;
+
+  lock_acquire (&futex_lock);
+  kaddr = futex_kaddr (uaddr);
+  if (kaddr == NULL || *kaddr != val)
+    {
+      lock_release (&futex_lock);
+      return -1;
+    }
+
+  f = futex_lookup (kaddr);
+  if (f == NULL)
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          lock_release (&futex_lock);
+          return -1;
+        }
+      f->paddr = vtop (kaddr);
+      list_init (&f->waiters);
+      hash_insert (&futexes, &f->elem);
+    }
+  sema_init (&w.sema, 0);
+  w.process = thread_current ()->process;
+  list_push_back (&f->waiters, &w.elem);
+  lock_release (&futex_lock);
+
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to CNT threads waiting on the int at user address
+   UADDR, in the order in which they began waiting.  Returns the
+   number of threads woken. */
+int
+futex_wake (int *uaddr, int cnt) 
+{
+  struct futex *f = NULL;
+  int woken = 0;
+  int *kaddr;
+
+  lock_acquire (&futex_lock);
+  kaddr = futex_kaddr (uaddr);
+  if (kaddr != NULL)
+    f = futex_lookup (kaddr);
+  if (f != NULL)
+    {
+      while (woken < cnt && !list_empty (&f->waiters)) 
+        {
+          struct list_elem *e = list_pop_front (&f->waiters);
+          sema_up (&list_entry (e, struct futex_waiter, elem)->sema);
+          woken++;
+        }
+      if (list_empty (&f->waiters)) 
+        {
+          hash_delete (&futexes, &f->elem);
+          free (f);
+        }
+    }
+  lock_release (&futex_lock);
+
+  return woken;
+}
+
+/* Wakes every thread of process P waiting on any futex, so that
+   they can die as P exits.  Each of them returns 0 from
+   futex_wait(), as futex users must expect spurious wakeups
+   anyway. */
+void
+futex_wake_process (const struct process *p) 
+{
+  struct hash_iterator i;
+  struct futex *empty;
+
+  lock_acquire (&futex_lock);
+  hash_first (&i, &futexes);
+  while (hash_next (&i)) 
+    {
+      struct futex *f = hash_entry (hash_cur (&i), struct futex, elem);
+      struct list_elem *e = list_begin (&f->waiters);
+
+      while (e != list_end (&f->waiters)) 
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+          e = list_next (e);
+          if (w->process == p) 
+            {
+              list_remove (&w->elem);
+              sema_up (&w->sema);
+            }
+        }
+    }
+
+  /* Deleting from the table would invalidate the iterator, so
+     free the queues that we emptied afterward. */
+  do
+    {
+      empty = NULL;
+      hash_first (&i, &futexes);
+      while (hash_next (&i)) 
+        {
+          struct futex *f = hash_entry (hash_cur (&i), struct futex, elem);
+          if (list_empty (&f->waiters)) 
+            {
+              empty = f;
+              break;
+            }
+        }
+      if (empty != NULL) 
+        {
+          hash_delete (&futexes, &empty->elem);
+          free (empty);
+        }
+    }
+  while (empty != NULL);
+  lock_release (&futex_lock);
+}
+
+/* Returns a hash of futex E_'s physical address. */
+static unsigned
+futex_hash (const struct hash_elem *e_, void *aux UNUSED) 
+{
+  const struct futex *f = hash_entry (e_, struct futex, elem);
+  return hash_int (f->paddr);
+}
+
+/* Returns true if futex A_'s physical address is less than B_'s. */
+static bool
+futex_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct futex *a = hash_entry (a_, struct futex, elem);
+  const struct futex *b = hash_entry (b_, struct futex, elem);
+
+  return a->paddr < b->paddr;
+}
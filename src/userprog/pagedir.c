@@ -5,6 +5,7 @@
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
@@ -248,9 +249,10 @@ active_pd (void)
    table.  When this happens, we have to "invalidate" the TLB by
    re-activating it.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   This function invalidates the TLB of each CPU on which PD is
+   the active page directory.  (If PD is not active then its
+   entries are not in the TLB, so there is no need to invalidate
+   anything.) */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
@@ -260,4 +262,5 @@ invalidate_pagedir (uint32_t *pd)
          "Translation Lookaside Buffers (TLBs)". */
       pagedir_activate (pd);
     } 
+  smp_tlb_shootdown (pd);
 }
@@ -14,9 +14,13 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/futex.h"
 
 /* Added for Project 2 */
 #include "filesys/off_t.h"
@@ -25,7 +29,45 @@
 
 #define MAX_ARG_CNT 32
 
+/* Distance between the tops of the user stacks of a process's
+   threads.  Stack N's top is N * STACK_SPACING below PHYS_BASE.
+   Each stack is a single page, like the main thread's stack 0,
+   so the unmapped space between them catches overflows. */
+#define STACK_SPACING (16 * PGSIZE)
+
+/* A thread of a process other than its main thread.  It stays
+   on the process's uthreads list after it exits, until a
+   sibling collects it with thread_join() or the process is
+   destroyed. */
+struct uthread
+  {
+    struct list_elem elem;      /* Element in process's uthreads. */
+    tid_t tid;                  /* Thread identifier. */
+    struct process *process;    /* Process it belongs to. */
+    int stack;                  /* User stack number. */
+    void *esp;                  /* Initial user stack pointer. */
+    void (*eip) (void);         /* User code to start at. */
+    struct semaphore dead;      /* Up when the thread exits. */
+    bool joined;                /* Is a thread joining it? */
+  };
+
+/* Cache of `struct process'es. */
+static struct slab_cache process_cache;
+
+/* Children of kernel threads, which belong to no process.  The
+   kernel threads share them, as the threads of a process share
+   theirs.  In practice only the main thread, in run_task(),
+   starts processes. */
+static struct list kernel_children;
+static struct lock kernel_children_lock;
+
 static thread_func start_process NO_RETURN;
+static thread_func start_thread NO_RETURN;
+static struct process *process_create (void);
+static struct list *children_lock (void);
+static void children_unlock (void);
+static void wake_child_waiters (struct process *);
+static void *stack_page (int stack);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 int tokenizer(char **argv, int max_cnt, char *str);
 void push_argument(char **argv, int argc, void **esp);
@@ -40,6 +82,16 @@ struct file
     bool deny_write;            /* Has file_deny_write() been called? */
   };
 
+/* Initializes the process module. */
+void
+process_init (void) 
+{
+  slab_cache_init (&process_cache, "process", sizeof (struct process),
+                   NULL);
+  list_init (&kernel_children);
+  lock_init (&kernel_children_lock, "kernel children");
+}
+
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -117,7 +169,10 @@ start_process (void *file_name_)
      threads/intr-stubs.S).  Because intr_exit takes all of its
      arguments on the stack in the form of a `struct intr_frame',
      we just point the stack pointer (%esp) to our stack frame
-     and jump to it. */
+     and jump to it.  Like intr_handler() on its way back to user
+     mode, leave the kernel first. */
+  intr_disable ();
+  kernel_lock_release ();
   asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
   NOT_REACHED ();
 }
@@ -136,46 +191,138 @@ process_wait (tid_t child_tid)
 {
   struct thread *child_thread = get_child(child_tid);
   int exit_status;
+  bool waited;
   
   // how to check whether child process has been killed by kernel?
   if (child_thread == NULL) return -1;
-  if (child_thread->wait_status) return -1;
+
+  /* Any thread of the process may wait, but only one of them
+     collects the status, and none once the process is exiting. */
+  children_lock();
+  waited = child_thread->wait_status || process_exiting();
+  child_thread->wait_status = true;
+  children_unlock();
+  if (waited) return -1;
 
   if (!child_thread->is_terminated) {
     sema_down(&child_thread->wait_sema);
   }
 
+  /* Woken by wake_child_waiters() because our process is exiting.
+     Its main thread frees the child. */
+  if (!child_thread->is_terminated) return -1;
+
   exit_status = child_thread->exit_status;
   remove_child(child_thread);
 
   return exit_status;
 }
 
-/* Free the current process's resources. */
+/* Free the current thread's resources.
+
+   The last thread of a process to exit is always its main
+   thread, which waits for the others, closes the process's
+   files, and reports the exit status to the parent.  The page
+   directory is left for process_cleanup(), which the reaper
+   thread calls once we have switched away for the last time, so
+   that exiting does not wait on tearing it down.
+
+   The other threads die as soon as they are about to return to
+   user mode.  Those asleep in a futex or waiting for a child are
+   woken up for it, but a thread blocked anywhere else in the
+   kernel, such as reading the keyboard in input_getc(), holds up
+   the main thread until that wait ends by itself. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
-  uint32_t *pd;
+  struct process *p = cur->process;
+
+  if (p != NULL && cur->uthread != NULL)
+    {
+      /* Give back our user stack and let a joiner collect us. */
+      struct uthread *ut = cur->uthread;
+      void *upage = stack_page (ut->stack);
+      void *kpage;
+
+      lock_acquire (&p->lock);
+      kpage = pagedir_get_page (p->pagedir, upage);
+      pagedir_clear_page (p->pagedir, upage);
+      palloc_free_page (kpage);
+      p->stack_slots &= ~(1u << ut->stack);
+      p->live_cnt--;
+      cond_broadcast (&p->exited, &p->lock);
+      lock_release (&p->lock);
+      sema_up (&ut->dead);
+      return;
+    }
+
+  if (p != NULL)
+    {
+      int fd;
+
+      /* Make the other threads die and wait for them. */
+      lock_acquire (&p->lock);
+      p->exiting = true;
+      lock_release (&p->lock);
+      futex_wake_process (p);
+      wake_child_waiters (p);
+      lock_acquire (&p->lock);
+      while (p->live_cnt > 1)
+        cond_wait (&p->exited, &p->lock);
+      p->live_cnt--;
+
+      /* Nobody can wait for our children anymore, so each of them
+         can be freed as soon as it dies. */
+      while (!list_empty (&p->children))
+        {
+          struct thread *child = list_entry (list_pop_front (&p->children),
+                                             struct thread, child_elem);
+          child->parent = NULL;
+          thread_release (child);
+        }
+      lock_release (&p->lock);
+
+      lock_acquire (&file_system_lock);
+      for (fd = 2; fd < FD_TABLE_SIZE; fd++)
+        if (p->fd_table[fd] != NULL)
+          {
+            file_close (p->fd_table[fd]);
+            p->fd_table[fd] = NULL;
+          }
+      lock_release (&file_system_lock);
+      cur->exit_status = p->exit_status;
+    }
 
   cur->is_terminated = true;
   sema_up(&cur->wait_sema);
+}
 
-  /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
-  pd = cur->pagedir;
-  if (pd != NULL) 
+/* Drops dead thread T's reference to its process, destroying
+   the process if T was its last thread.  Called by the reaper
+   thread after T has switched away for the last time, so the
+   page directory cannot be active anymore once the last
+   reference is gone. */
+void
+process_cleanup (struct thread *t)
+{
+  struct process *p = t->process;
+  bool last;
+
+  if (p == NULL)
+    return;
+  t->process = NULL;
+
+  lock_acquire (&p->lock);
+  last = --p->ref_cnt == 0;
+  lock_release (&p->lock);
+  if (last) 
     {
-      /* Correct ordering here is crucial.  We must set
-         cur->pagedir to NULL before switching page directories,
-         so that a timer interrupt can't switch back to the
-         process page directory.  We must activate the base page
-         directory before destroying the process's page
-         directory, or our active page directory will be one
-         that's been freed (and cleared). */
-      cur->pagedir = NULL;
-      pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      while (!list_empty (&p->uthreads))
+        free (list_entry (list_pop_front (&p->uthreads),
+                          struct uthread, elem));
+      pagedir_destroy (p->pagedir);
+      slab_free (&process_cache, p);
     }
 }
 
@@ -186,42 +333,300 @@ void
 process_activate (void)
 {
   struct thread *t = thread_current ();
+  struct cpu *cpu = cpu_current ();
+  uint32_t *pd = t->process != NULL ? t->process->pagedir : NULL;
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  Threads of one process share
+     them, so switching between them skips reloading CR3, which
+     would flush the TLB. */
+  if (pd != cpu->pagedir) 
+    {
+      pagedir_activate (pd);
+      cpu->pagedir = pd;
+    }
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
   tss_update ();
 }
 
+/* Creates a process with an empty address space and no open
+   files, whose main thread is the current thread.  Returns the
+   new process, or a null pointer if memory is short. */
+static struct process *
+process_create (void) 
+{
+  struct process *p = slab_alloc (&process_cache);
+
+  if (p == NULL)
+    return NULL;
+  memset (p, 0, sizeof *p);
+  p->pagedir = pagedir_create ();
+  if (p->pagedir == NULL) 
+    {
+      slab_free (&process_cache, p);
+      return NULL;
+    }
+  p->main = thread_current ();
+  lock_init (&p->lock, "process");
+  p->ref_cnt = p->live_cnt = 1;
+  cond_init (&p->exited);
+  p->stack_slots = 1;
+  list_init (&p->uthreads);
+  list_init (&p->children);
+  return p;
+}
+
+/* Makes the current process exit with STATUS: its threads die
+   the next time they would return to user mode, or, if blocked
+   in a futex or waiting for a child, right away.  Returns true
+   if successful, false if the process was already exiting, in
+   which case the earlier status stands.  In a kernel thread,
+   does nothing and returns true. */
+bool
+process_terminate (int status) 
+{
+  struct process *p = thread_current ()->process;
+  bool first;
+
+  if (p == NULL)
+    return true;
+
+  lock_acquire (&p->lock);
+  first = !p->exiting;
+  if (first) 
+    {
+      p->exiting = true;
+      p->exit_status = status;
+    }
+  lock_release (&p->lock);
+
+  if (first) 
+    {
+      futex_wake_process (p);
+      wake_child_waiters (p);
+    }
+  return first;
+}
+
+/* Returns true if the current thread belongs to a process that
+   is exiting, so that it must die instead of returning to user
+   mode. */
+bool
+process_exiting (void) 
+{
+  struct process *p = thread_current ()->process;
+
+  return p != NULL && p->exiting;
+}
+
+/* Returns the lowest user address in user stack number STACK's
+   page. */
+static void *
+stack_page (int stack) 
+{
+  return (uint8_t *) PHYS_BASE - stack * STACK_SPACING - PGSIZE;
+}
+
+/* Starts a new thread in the current process that calls user
+   function ENTRY as ENTRY(FUNC, AUX) on a fresh user stack.
+   ENTRY must not return.  Returns the new thread's tid, or
+   TID_ERROR if the process already has PROCESS_THREAD_MAX
+   threads, is exiting, or memory is short. */
+tid_t
+process_thread_create (void *entry, void *func, void *aux)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  struct uthread *ut;
+  struct thread *t;
+  uint32_t *kpage;
+  int stack;
+
+  ut = malloc (sizeof *ut);
+  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (ut == NULL || kpage == NULL)
+    goto error;
+
+  /* The new thread starts as if ENTRY had been called with
+     FUNC and AUX as arguments and a null return address. */
+  kpage[PGSIZE / sizeof *kpage - 1] = (uint32_t) aux;
+  kpage[PGSIZE / sizeof *kpage - 2] = (uint32_t) func;
+  kpage[PGSIZE / sizeof *kpage - 3] = 0;
+
+  lock_acquire (&p->lock);
+  for (stack = 1; stack < PROCESS_THREAD_MAX; stack++)
+    if ((p->stack_slots & (1u << stack)) == 0)
+      break;
+  if (p->exiting || stack >= PROCESS_THREAD_MAX
+      || !pagedir_set_page (p->pagedir, stack_page (stack), kpage, true))
+    {
+      lock_release (&p->lock);
+      goto error;
+    }
+  p->stack_slots |= 1u << stack;
+  p->ref_cnt++;
+  p->live_cnt++;
+  ut->process = p;
+  ut->stack = stack;
+  ut->esp = (uint8_t *) stack_page (stack) + PGSIZE - 3 * sizeof *kpage;
+  ut->eip = (void (*) (void)) entry;
+  sema_init (&ut->dead, 0);
+  ut->joined = false;
+  ut->tid = TID_ERROR;
+  list_push_back (&p->uthreads, &ut->elem);
+  lock_release (&p->lock);
+
+  ut->tid = thread_create (cur->name, PRI_DEFAULT, start_thread, ut);
+  if (ut->tid == TID_ERROR) 
+    {
+      lock_acquire (&p->lock);
+      list_remove (&ut->elem);
+      pagedir_clear_page (p->pagedir, stack_page (stack));
+      p->stack_slots &= ~(1u << stack);
+      p->ref_cnt--;
+      p->live_cnt--;
+      lock_release (&p->lock);
+      goto error;
+    }
+
+  /* Only a process's main thread is its parent's child. */
+  t = get_child (ut->tid);
+  if (t != NULL)
+    remove_child (t);
+  return ut->tid;
+
+ error:
+  palloc_free_page (kpage);
+  free (ut);
+  return TID_ERROR;
+}
+
+/* A thread function that starts a thread created by
+   process_thread_create() running user code. */
+static void
+start_thread (void *ut_) 
+{
+  struct uthread *ut = ut_;
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
+
+  t->process = ut->process;
+  t->uthread = ut;
+  process_activate ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = ut->eip;
+  if_.esp = ut->esp;
+  intr_disable ();
+  kernel_lock_release ();
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Waits for thread TID of the current process to exit.  Returns
+   0 if successful, or -1 if TID is not a thread of the current
+   process other than its main thread and the caller, or if
+   another thread has already joined it. */
+int
+process_thread_join (tid_t tid)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  struct uthread *ut = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&p->lock);
+  for (e = list_begin (&p->uthreads); e != list_end (&p->uthreads);
+       e = list_next (e))
+    {
+      struct uthread *u = list_entry (e, struct uthread, elem);
+      if (u->tid == tid && !u->joined && u != cur->uthread)
+        {
+          ut = u;
+          ut->joined = true;
+          break;
+        }
+    }
+  lock_release (&p->lock);
+  if (ut == NULL)
+    return -1;
+
+  sema_down (&ut->dead);
+
+  lock_acquire (&p->lock);
+  list_remove (&ut->elem);
+  lock_release (&p->lock);
+  free (ut);
+  return 0;
+}
+
+/* Ends the current thread, unless it is its process's main
+   thread.  The main thread instead waits for the process's other
+   threads to exit and then returns, so that the caller can end
+   the process. */
+void
+process_thread_exit (void)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+
+  if (cur->uthread != NULL)
+    thread_exit ();
+
+  lock_acquire (&p->lock);
+  while (p->live_cnt > 1)
+    cond_wait (&p->exited, &p->lock);
+  lock_release (&p->lock);
+}
+
 /* Added for file descriptor in Project 2. */
 int process_fd_open(struct file *file)
 {
-  struct thread *t = thread_current ();
+  struct process *p = thread_current ()->process;
   int i;
+  lock_acquire(&p->lock);
   for (i = 2; i < FD_TABLE_SIZE; i++)
   {
-    if (t->fd_table[i] == NULL)
+    if (p->fd_table[i] == NULL)
     {
-      t->fd_table[i] = file;
+      p->fd_table[i] = file;
       break;
     }
   }
+  lock_release(&p->lock);
   return i;
 }
 
+/* Returns the file open as FD, or a null pointer.  The caller
+   must hold file_system_lock for as long as it uses the file,
+   since another thread of the process may close it. */
 struct file * process_fd_file_ptr(int fd)
 {
-  struct thread *t = thread_current ();
-  return t->fd_table[fd];
+  struct process *p = thread_current ()->process;
+  struct file *file;
+  lock_acquire(&p->lock);
+  file = p->fd_table[fd];
+  lock_release(&p->lock);
+  return file;
 }
 
-void process_fd_close(int fd)// Necessary?
+/* Closes FD.  Returns false if FD was not open.  The caller
+   must hold file_system_lock. */
+bool process_fd_close(int fd)
 {
-  struct thread *t = thread_current ();
-  file_close(t->fd_table[fd]);
-  t->fd_table[fd] = NULL;
+  struct process *p = thread_current ()->process;
+  struct file *file;
+  lock_acquire(&p->lock);
+  file = p->fd_table[fd];
+  p->fd_table[fd] = NULL;
+  lock_release(&p->lock);
+  if (file == NULL) return false;
+  file_close(file);
+  return true;
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -308,8 +713,8 @@ load (const char *file_name, void (**eip) (void), void **esp)
   int i;
 
   /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
-  if (t->pagedir == NULL) 
+  t->process = process_create ();
+  if (t->process == NULL) 
     goto done;
   process_activate ();
 
@@ -556,8 +961,8 @@ install_page (void *upage, void *kpage, bool writable)
 
   /* Verify that there's not already a page at that virtual
      address, then map our page there. */
-  return (pagedir_get_page (t->pagedir, upage) == NULL
-          && pagedir_set_page (t->pagedir, upage, kpage, writable));
+  return (pagedir_get_page (t->process->pagedir, upage) == NULL
+          && pagedir_set_page (t->process->pagedir, upage, kpage, writable));
 }
 
 int tokenizer(char **argv, int max_cnt, char *str)
@@ -625,22 +1030,91 @@ void push_argument(char **argv, int argc, void **esp)
   return;
 }
 
+/* Acquires the lock on the current process's children and
+   returns the list of them.  Kernel threads get the list they
+   share. */
+static struct list *
+children_lock (void) 
+{
+  struct process *p = thread_current ()->process;
+
+  if (p == NULL)
+    {
+      lock_acquire (&kernel_children_lock);
+      return &kernel_children;
+    }
+  lock_acquire (&p->lock);
+  return &p->children;
+}
+
+/* Releases the lock acquired by children_lock(). */
+static void
+children_unlock (void) 
+{
+  struct process *p = thread_current ()->process;
+
+  lock_release (p != NULL ? &p->lock : &kernel_children_lock);
+}
+
+/* Wakes up the threads of P, which is exiting, that are waiting
+   for a child to exit, so that they can die.  process_wait()
+   tells them from a child's real exit by the child not having
+   terminated. */
+static void
+wake_child_waiters (struct process *p) 
+{
+  struct list_elem *e;
+
+  ASSERT (p->exiting);
+
+  lock_acquire (&p->lock);
+  for (e = list_begin (&p->children); e != list_end (&p->children);
+       e = list_next (e)) 
+    {
+      struct thread *child = list_entry (e, struct thread, child_elem);
+      if (child->wait_status && !child->is_terminated)
+        sema_up (&child->wait_sema);
+    }
+  lock_release (&p->lock);
+}
+
+/* Makes new thread T a child of the current process, which
+   thread_create() calls for every thread it creates.  Any thread
+   of the process can then wait for it. */
+void
+process_add_child (struct thread *t) 
+{
+  struct list *children = children_lock ();
+  list_push_back (children, &t->child_elem);
+  children_unlock ();
+}
+
 struct thread *get_child(tid_t pid)
 {
-  struct thread *t = thread_current();
+  struct list *children = children_lock();
   struct list_elem *e;
+  struct thread *found = NULL;
   
-  for (e = list_begin (&t->children); e != list_end (&t->children);
+  for (e = list_begin (children); e != list_end (children);
        e = list_next (e))
   {
     struct thread *child = list_entry(e, struct thread, child_elem);
-    if (child->tid == pid) return child;
+    if (child->tid == pid)
+    {
+      found = child;
+      break;
+    }
   }
-  return NULL;
+  children_unlock();
+  return found;
 }
 
+/* Removes CHILD from the current process's children and frees
+   it once it is safe to do so. */
 void remove_child(struct thread *child)
 {
+  children_lock();
   list_remove(&child->child_elem);
-  palloc_free_page(child);
+  children_unlock();
+  thread_release(child);
 }
\ No newline at end of file
@@ -1,18 +1,55 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include "threads/synch.h"
 #include "threads/thread.h"
 
+#define FD_TABLE_SIZE 128
+
+/* Most threads in one process, including its main thread. */
+#define PROCESS_THREAD_MAX 16
+
+/* A user process: an address space and open files, shared by
+   one or more threads.  The thread that loads the program is
+   its main thread.  Others are started by the thread_create
+   system call, each with its own user stack, and the process
+   lives until the last of them has been reaped. */
+struct process
+  {
+    /* Set when the process is created. */
+    uint32_t *pagedir;                  /* Page directory. */
+    struct thread *main;                /* Main thread. */
+
+    struct lock lock;                   /* Protects the members below. */
+    int ref_cnt;                        /* Threads not yet reaped. */
+    int live_cnt;                       /* Threads not yet exited. */
+    struct condition exited;            /* Signaled when a thread exits. */
+    bool exiting;                       /* Must its threads die? */
+    int exit_status;                    /* Status reported to parent. */
+    unsigned stack_slots;               /* Bit N set: stack N in use. */
+    struct list uthreads;               /* Threads other than main. */
+    struct list children;               /* Main threads of children. */
+    struct file *fd_table[FD_TABLE_SIZE]; /* Open files, by fd. */
+  };
+
+void process_init (void);
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+void process_cleanup (struct thread *);
+bool process_terminate (int status);
+bool process_exiting (void);
+tid_t process_thread_create (void *entry, void *func, void *aux);
+int process_thread_join (tid_t);
+void process_thread_exit (void);
+void process_add_child (struct thread *);
 struct thread *get_child(tid_t pid);
 void remove_child(struct thread *child);
 
 /* Project 2 */
 int process_fd_open(struct file *file);
 struct file * process_fd_file_ptr(int fd);
-void process_fd_close(int fd);
+bool process_fd_close(int fd);
 
 #endif /* userprog/process.h */
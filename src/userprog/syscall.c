@@ -5,11 +5,14 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 #include <string.h>
 #include "threads/synch.h"
 /* Added for Project 2 */
 #include "filesys/filesys.h"
 #include "userprog/process.h"
+#include "userprog/futex.h"
+#include "userprog/pagedir.h"
 #include "filesys/file.h"
 #include <devices/input.h>
 
@@ -19,7 +22,7 @@ int get_arg_cnt(int);
 void
 syscall_init (void) 
 {
-  lock_init(&file_system_lock);
+  lock_init(&file_system_lock, "file system");
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -30,18 +33,8 @@ void halt(void)
 
 void exit(int status)
 {
-  thread_current()->exit_status = status;
-  int i;
-  for (i = 2; i < FD_TABLE_SIZE; i++)
-  {
-    struct file * file = process_fd_file_ptr(i); 
-    if(file != NULL) 
-    {
-      file_allow_write(file);
-      close(i);
-    }
-  }
-  printf("%s: exit(%d)\n", thread_name(), status);
+  if (process_terminate(status))
+    printf("%s: exit(%d)\n", thread_name(), status);
   thread_exit();
 }
 
@@ -63,6 +56,39 @@ int wait (pid_t pid)
   return process_wait(pid);
 }
 
+/* Sets this process's stride scheduling tickets.  Returns false
+   if TICKETS is out of range. */
+bool settickets (int tickets)
+{
+  if (tickets < TICKETS_MIN || tickets > TICKETS_MAX) return false;
+  thread_set_tickets(tickets);
+  return true;
+}
+
+/* Makes this process a real-time process that gets RUNTIME ticks
+   of CPU time in every PERIOD ticks, or, if RUNTIME is 0, a
+   normal process again.  Returns false if the arguments are out
+   of range or the CPU time is not available. */
+bool setedf (int runtime, int period)
+{
+  if (runtime == 0) return thread_set_policy(SCHED_NORMAL, 0, 0);
+  if (runtime < 0 || period < runtime) return false;
+  return thread_set_policy(SCHED_EDF, runtime, period);
+}
+
+/* Makes this process run only when nothing else is ready if IDLE
+   is true, or a normal process again if it is false. */
+void setidle (bool idle)
+{
+  thread_set_policy(idle ? SCHED_IDLE : SCHED_NORMAL, 0, 0);
+}
+
+/* Returns the number of timer ticks since the OS booted. */
+int uptime (void)
+{
+  return timer_ticks();
+}
+
 void validate_user_pointer(void *pointer)
 {
   if (pointer == NULL || !(pointer < PHYS_BASE && pointer > (void *)0x8048000)) // >= ?
@@ -71,6 +97,18 @@ void validate_user_pointer(void *pointer)
   }
 }
 
+/* Kills the process unless ADDR is a mapped user address
+   aligned for an int, as futexes require. */
+void validate_futex_addr(int *addr)
+{
+  validate_user_pointer(addr);
+  if ((uintptr_t)addr % sizeof *addr != 0
+      || pagedir_get_page(thread_current()->process->pagedir, addr) == NULL)
+  {
+    exit(-1);
+  }
+}
+
 void validate_fd(int fd)
 {
   if (!(fd >= 0 && fd < FD_TABLE_SIZE))
@@ -121,6 +159,28 @@ int get_arg_cnt(int syscall_num)
       return 1;
     case SYS_CLOSE:
       return 1;
+    case SYS_SCHEDSTAT:
+      return 0;
+    case SYS_SETTICKETS:
+      return 1;
+    case SYS_SETEDF:
+      return 2;
+    case SYS_SETIDLE:
+      return 1;
+    case SYS_LOCKSTAT:
+      return 0;
+    case SYS_FUTEX_WAIT:
+      return 2;
+    case SYS_FUTEX_WAKE:
+      return 2;
+    case SYS_THREAD_CREATE:
+      return 3;
+    case SYS_THREAD_JOIN:
+      return 1;
+    case SYS_THREAD_EXIT:
+      return 0;
+    case SYS_UPTIME:
+      return 0;
     default:
       printf("Syscall number error: %d\n", syscall_num);
       return 0;
@@ -183,11 +243,65 @@ syscall_handler (struct intr_frame *f)
     case SYS_CLOSE:
       close(args[0]);
       break;
+    case SYS_SCHEDSTAT:
+      thread_print_stats();
+      break;
+    case SYS_SETTICKETS:
+      f->eax = settickets(args[0]);
+      break;
+    case SYS_SETEDF:
+      f->eax = setedf(args[0], args[1]);
+      break;
+    case SYS_SETIDLE:
+      setidle(args[0]);
+      break;
+    case SYS_LOCKSTAT:
+      lockstat_print();
+      break;
+    case SYS_FUTEX_WAIT:
+      validate_futex_addr((int *)args[0]);
+      f->eax = futex_wait((int *)args[0], args[1]);
+      break;
+    case SYS_FUTEX_WAKE:
+      validate_futex_addr((int *)args[0]);
+      f->eax = futex_wake((int *)args[0], args[1]);
+      break;
+    case SYS_THREAD_CREATE:
+      f->eax = process_thread_create((void *)args[0], (void *)args[1],
+                                     (void *)args[2]);
+      break;
+    case SYS_THREAD_JOIN:
+      f->eax = process_thread_join((tid_t)args[0]);
+      break;
+    case SYS_THREAD_EXIT:
+      process_thread_exit();
+      exit(0);
+      break;
+    case SYS_UPTIME:
+      f->eax = uptime();
+      break;
     default:
       break;
   }
 }
 
+/* Returns the file open as FD, holding file_system_lock so that
+   no other thread of the process can close it while we use it.
+   Kills the process if FD is not open.  The caller must release
+   file_system_lock. */
+static struct file *lock_fd_file(int fd)
+{
+  validate_fd(fd);
+  lock_acquire(&file_system_lock);
+  struct file * file = process_fd_file_ptr(fd);
+  if (file == NULL)
+  {
+    lock_release(&file_system_lock);
+    exit(-1);
+  }
+  return file;
+}
+
 int write(int fd, const void *buffer, unsigned size)
 {
   validate_fd(fd);
@@ -198,11 +312,7 @@ int write(int fd, const void *buffer, unsigned size)
     written_size = size;
   }else if (fd >= 2)
   {
-    struct file * file = process_fd_file_ptr(fd);
-    // validate_user_pointer((void *)file);
-    if(file == NULL) exit(-1);
-
-    lock_acquire(&file_system_lock);
+    struct file * file = lock_fd_file(fd);
     written_size = file_write(file, buffer, size);
     lock_release(&file_system_lock);
   }
@@ -224,11 +334,7 @@ int read (int fd, void *buffer, unsigned size)
     read_size = i;
   }else if(fd >= 2)
   {
-    struct file * file = process_fd_file_ptr(fd);
-    // validate_user_pointer((void *)file);
-    if(file == NULL) exit(-1);
-
-    lock_acquire(&file_system_lock);
+    struct file * file = lock_fd_file(fd);
     read_size = file_read(file, buffer, size);
     lock_release(&file_system_lock); 
   }
@@ -268,10 +374,7 @@ int open (const char *file)
 
 int filesize (int fd)
 {
-  struct file * file = process_fd_file_ptr(fd);
-  // if (file == NULL) return -1;// Not necessary? ASSERT error in file_length or just return -1. Which one is better?
-
-  lock_acquire(&file_system_lock); 
+  struct file * file = lock_fd_file(fd);
   int size = file_length(file);
   lock_release(&file_system_lock);
 
@@ -280,19 +383,15 @@ int filesize (int fd)
 
 void seek (int fd, unsigned position)
 {
-  struct file * file = process_fd_file_ptr(fd);
-  
-  lock_acquire(&file_system_lock); 
+  struct file * file = lock_fd_file(fd);
   file_seek(file, position);
   lock_release(&file_system_lock); 
 }
 
 unsigned tell (int fd)
 {
-  struct file * file = process_fd_file_ptr(fd);
-  unsigned pos;
-  lock_acquire(&file_system_lock); 
-  pos = file_tell(file);
+  struct file * file = lock_fd_file(fd);
+  unsigned pos = file_tell(file);
   lock_release(&file_system_lock); 
 
   return pos;
@@ -300,14 +399,12 @@ unsigned tell (int fd)
 
 void close (int fd)
 {
-  struct thread *t = thread_current ();
+  bool closed;
   validate_fd(fd);
-  // validate_user_pointer((void *)t->fd_table[fd]);
-  if (t->fd_table[fd] == NULL) exit(-1);
 
   lock_acquire(&file_system_lock); 
-  file_close(t->fd_table[fd]);
-  t->fd_table[fd] = NULL;
+  closed = process_fd_close(fd);
   lock_release(&file_system_lock);
+  if (!closed) exit(-1);
 }
   
@@ -14,7 +14,12 @@ void halt(void);
 void exit(int status);
 pid_t exec (const char *cmd_line);
 int wait (pid_t pid);
+bool settickets (int tickets);
+bool setedf (int runtime, int period);
+void setidle (bool idle);
+int uptime (void);
 void validate_user_pointer(void *pointer);
+void validate_futex_addr(int *addr);
 void validate_fd(int fd);
 void get_syscall_arg(void *sp, int *arg, int arg_cnt);
 int write(int fd, const void *buffer, unsigned size);
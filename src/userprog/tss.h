@@ -3,9 +3,10 @@
 
 #include <stdint.h>
 
+struct cpu;
 struct tss;
 void tss_init (void);
-struct tss *tss_get (void);
+struct tss *tss_get (const struct cpu *);
 void tss_update (void);
 
 #endif /* userprog/tss.h */